@@ -0,0 +1,596 @@
+#include "students.h"
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#ifdef G_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+// ================== BENCHMARKS ==================
+
+// Times the record engine the way the window drives it, on synthetic
+// students, at each of a range of store sizes:
+//
+//   insert         store_insert_batch into an empty store, as an import does
+//   save           save_data until the snapshot is on disk
+//   load           load_data from that snapshot (warm page cache)
+//   sort:KEY       building a column's permutation
+//   search:KIND    search_students for plain text, a reg prefix and filters
+//   model_rebuild  the rows refresh_table shows for a filter, in name order
+//   stats          the numbers update_statistics puts on the cards
+//   analytics      the group-by pass behind the analytics panel
+//   edit, delete   one store change plus its journal entry, as the dialogs do
+//   search:edited  the first text search after renaming a student
+//
+// GTK is not linked, so widget work (binding rows, drawing) is not covered.
+// Each line reports latency percentiles over the samples taken, throughput
+// in records or operations per second, and the process's peak RSS so far.
+// Sizes run smallest first, so the peak belongs to the largest size yet.
+//
+// --json writes one JSON object per result line. --baseline compares p50
+// latencies against such a file from an earlier build and exits 1 when any
+// is slower by more than --threshold percent (and more than timer noise).
+//
+// Everything runs in a scratch directory, removed afterwards, unless --dir
+// names one to use instead.
+
+#define BENCH_MAX_WORK 200000000.0  // Record visits per latency series, caps samples at large sizes
+#define BENCH_REG_SPACE 50000000    // Distinct reg numbers the generator can issue
+#define BENCH_NOISE_MS 0.005        // Baseline differences below this are timer noise
+
+typedef struct {
+    const char *op;
+    const char *unit;   // "records/s" or "ops/s"
+    int records;        // Store size
+    double items;       // Records or operations per sample, for throughput
+    GArray *samples;    // gint64 nanoseconds
+} BenchResult;
+
+static char *opt_sizes = NULL;
+static int opt_runs = 5;
+static int opt_samples = 200;
+static int opt_seed = 42;
+static char *opt_json = NULL;
+static char *opt_baseline = NULL;
+static double opt_threshold = 10.0;
+static char *opt_dir = NULL;
+
+static FILE *json_fp = NULL;
+static GHashTable *baseline = NULL;  // "op@records" -> p50 ms (double *)
+static int regressions = 0;
+static double bench_sink;           // Keeps computed values alive
+
+// ================== SYNTHETIC STUDENTS ==================
+
+// Names, distributions and reg numbers in the shape of a registrar's
+// export. Reg numbers read program letter, intake year, institution code,
+// a three-digit group and a four-digit roll number, as in P24GPTC4170010.
+
+static const char *const male_names[] = {
+    "Aarav", "Abhinav", "Adithya", "Akash", "Amal", "Anand", "Arjun", "Arun", "Ashwin", "Bharath",
+    "Deepak", "Dhruv", "Gautham", "Hari", "Harsh", "Jithin", "Karthik", "Kiran", "Krishna", "Manoj",
+    "Midhun", "Nikhil", "Pranav", "Rahul", "Rajesh", "Rohan", "Sachin", "Sanjay", "Siddharth", "Sreehari",
+    "Suresh", "Tharun", "Varun", "Vignesh", "Vishnu", "Yash"
+};
+
+static const char *const female_names[] = {
+    "Aadhya", "Aishwarya", "Ananya", "Anjali", "Aparna", "Arya", "Athira", "Bhavana", "Devika", "Diya",
+    "Divya", "Gayathri", "Gowri", "Isha", "Kavya", "Keerthana", "Lakshmi", "Meera", "Nandana", "Neha",
+    "Nikitha", "Pooja", "Priya", "Reshma", "Riya", "Sandra", "Shreya", "Sneha", "Sruthi", "Swathi",
+    "Thejaswini", "Varsha"
+};
+
+static const char *const surnames[] = {
+    "Agarwal", "Banerjee", "Bhat", "Chandran", "Das", "Desai", "Gupta", "Iyer", "Jain", "Joseph",
+    "Kapoor", "Krishnan", "Kumar", "Menon", "Mishra", "Mohan", "Nair", "Naidu", "Patel", "Pillai",
+    "Rao", "Reddy", "Sharma", "Singh", "Sinha", "Thomas", "Varghese", "Verma", "Warrier", "Yadav"
+};
+
+// Weights in the order of branch_choices, program_choices and gender_choices
+static const int branch_weights[] = { 30, 15, 18, 12, 12, 10, 3 };
+static const int program_weights[] = { 70, 10, 20 };
+static const int gender_weights[] = { 55, 43, 2 };
+static const char program_letters[] = { 'B', 'M', 'P' };
+static const char *const institutions[][4] = {
+    { "GECT", "CETV", "NITC", "TKMC" },  // BTECH
+    { "IIMK", "SCMS", "ASAP", "DCSM" },  // MBA
+    { "GPTC", "WPTC", "CPTC", "MPTC" }   // DIPLOMA
+};
+
+static int pick_weighted(GRand *rng, const int *weights, int n) {
+    int total = 0;
+    for (int i = 0; i < n; i++) total += weights[i];
+    int r = g_rand_int_range(rng, 0, total);
+    for (int i = 0; i < n; i++) {
+        if (r < weights[i]) return i;
+        r -= weights[i];
+    }
+    return n - 1;
+}
+
+static double pick_normal(GRand *rng, double mean, double sd) {
+    double u = 1.0 - g_rand_double(rng);
+    double v = g_rand_double(rng);
+    return mean + sd * sqrt(-2.0 * log(u)) * cos(2.0 * G_PI * v);
+}
+
+static guint16 branch_codes[G_N_ELEMENTS(branch_weights)];
+static guint16 program_codes[G_N_ELEMENTS(program_weights)];
+static guint16 gender_codes[G_N_ELEMENTS(gender_weights)];
+static guint16 subject_codes[6];
+
+// Intern the strings generated students use. Always in the same order, so
+// after a dict_reset the codes come out as before.
+static void intern_choices() {
+    for (guint i = 0; i < G_N_ELEMENTS(branch_codes); i++) branch_codes[i] = dict_intern(DICT_BRANCH, branch_choices[i]);
+    for (guint i = 0; i < G_N_ELEMENTS(program_codes); i++) program_codes[i] = dict_intern(DICT_PROGRAM, program_choices[i]);
+    for (guint i = 0; i < G_N_ELEMENTS(gender_codes); i++) gender_codes[i] = dict_intern(DICT_GENDER, gender_choices[i]);
+    for (int j = 0; j < 6; j++) subject_codes[j] = dict_intern(DICT_SUBJECT, default_subject_names[j]);
+}
+
+// Fill out[0..n) with students whose reg numbers are unique for any
+// first + n up to BENCH_REG_SPACE. Call intern_choices first.
+static void generate_students(GRand *rng, int first, int n, Student *out) {
+    for (int i = 0; i < n; i++) {
+        Student *s = &out[i];
+        memset(s, 0, sizeof(*s));
+        int branch = pick_weighted(rng, branch_weights, G_N_ELEMENTS(branch_weights));
+        int program = pick_weighted(rng, program_weights, G_N_ELEMENTS(program_weights));
+        int gender = pick_weighted(rng, gender_weights, G_N_ELEMENTS(gender_weights));
+        s->branch = branch_codes[branch];
+        s->program = program_codes[program];
+        s->gender = gender_codes[gender];
+
+        const char *given = gender == 1 || (gender == 2 && g_rand_boolean(rng))
+            ? female_names[g_rand_int_range(rng, 0, G_N_ELEMENTS(female_names))]
+            : male_names[g_rand_int_range(rng, 0, G_N_ELEMENTS(male_names))];
+        snprintf(s->name, sizeof(s->name), "%s %s", given, surnames[g_rand_int_range(rng, 0, G_N_ELEMENTS(surnames))]);
+
+        // A fixed permutation of the reg number space, so neighbouring
+        // records do not share a roll number run
+        guint64 k = (guint64)(first + i) * 4435761u % BENCH_REG_SPACE;
+        snprintf(s->reg_num, sizeof(s->reg_num), "%c%02d%s%03d%04d", program_letters[program],
+                 20 + (int)(k / 10000 % 5), institutions[program][g_rand_int_range(rng, 0, 4)],
+                 (int)(k / 50000), (int)(k % 10000));
+        snprintf(s->phone, sizeof(s->phone), "%d%09d", g_rand_int_range(rng, 6, 10),
+                 g_rand_int_range(rng, 0, 1000000000));
+        s->age = CLAMP((int)lround(pick_normal(rng, program == 1 ? 24 : 20, 1.8)), 16, 60);
+
+        double total = 0;
+        double ability = pick_normal(rng, 66, 12);
+        for (int j = 0; j < 6; j++) {
+            s->subjects[j].subject_name = subject_codes[j];
+            s->subjects[j].marks = (float)CLAMP(round(pick_normal(rng, ability, 9)), 0, 100);
+            total += s->subjects[j].marks;
+        }
+        s->gpa = (float)(CLAMP(round((total / 60.0 + pick_normal(rng, 0, 0.3)) * 100), 0, 1000) / 100.0);
+    }
+}
+
+// ================== TIMING ==================
+
+static gint64 bench_now_ns() {
+#ifdef G_OS_UNIX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (gint64)ts.tv_sec * G_GINT64_CONSTANT(1000000000) + ts.tv_nsec;
+#else
+    return g_get_monotonic_time() * 1000;
+#endif
+}
+
+static long bench_peak_rss_kb() {
+#ifdef G_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+}
+
+// How many latency samples to take of an operation visiting n records.
+static int bench_samples(int n) {
+    return CLAMP((int)(BENCH_MAX_WORK / MAX(n, 1)), MIN(opt_runs, opt_samples), opt_samples);
+}
+
+static BenchResult *result_new(const char *op, const char *unit, int records, double items) {
+    BenchResult *r = g_new0(BenchResult, 1);
+    r->op = op;
+    r->unit = unit;
+    r->records = records;
+    r->items = items;
+    r->samples = g_array_new(FALSE, FALSE, sizeof(gint64));
+    return r;
+}
+
+static void result_add(BenchResult *r, gint64 start) {
+    gint64 elapsed = bench_now_ns() - start;
+    g_array_append_val(r->samples, elapsed);
+}
+
+static int compare_gint64(const void *a, const void *b) {
+    gint64 x = *(const gint64 *)a, y = *(const gint64 *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted samples, in milliseconds.
+static double sample_percentile(GArray *sorted, double p) {
+    int rank = (int)ceil(p * sorted->len);
+    return g_array_index(sorted, gint64, CLAMP(rank, 1, (int)sorted->len) - 1) / 1e6;
+}
+
+// Print r, write it to the JSON file and check it against the baseline.
+static void result_report(BenchResult *r) {
+    g_array_sort(r->samples, compare_gint64);
+    double sum = 0;
+    for (guint i = 0; i < r->samples->len; i++) sum += g_array_index(r->samples, gint64, i);
+    double mean = sum / r->samples->len / 1e6;
+    double p50 = sample_percentile(r->samples, 0.5);
+    double p90 = sample_percentile(r->samples, 0.9);
+    double p99 = sample_percentile(r->samples, 0.99);
+    double max = sample_percentile(r->samples, 1.0);
+    double throughput = mean > 0 ? r->items / (mean / 1e3) : 0;
+    long rss = bench_peak_rss_kb();
+
+    char delta[48] = "";
+    char *key = g_strdup_printf("%s@%d", r->op, r->records);
+    const double *before = baseline ? g_hash_table_lookup(baseline, key) : NULL;
+    if (before && *before > 0) {
+        double change = (p50 - *before) / *before * 100.0;
+        gboolean slower = change > opt_threshold && p50 - *before > BENCH_NOISE_MS;
+        snprintf(delta, sizeof(delta), "  %+.1f%%%s", change, slower ? " REGRESSION" : "");
+        if (slower) regressions++;
+    }
+    g_free(key);
+
+    g_print("%-16s %9d %6u %10.3f %10.3f %10.3f %10.3f %14.0f %-9s %8ld MB%s\n", r->op, r->records,
+            r->samples->len, p50, p90, p99, max, throughput, r->unit, rss / 1024, delta);
+    if (json_fp) {
+        fprintf(json_fp,
+                "{\"op\": \"%s\", \"records\": %d, \"samples\": %u, \"mean_ms\": %.6f, \"p50_ms\": %.6f, "
+                "\"p90_ms\": %.6f, \"p99_ms\": %.6f, \"max_ms\": %.6f, \"throughput\": %.1f, "
+                "\"unit\": \"%s\", \"peak_rss_kb\": %ld}\n",
+                r->op, r->records, r->samples->len, mean, p50, p90, p99, max, throughput, r->unit, rss);
+        fflush(json_fp);
+    }
+    g_array_unref(r->samples);
+    g_free(r);
+}
+
+// Value after "key": on a result line, or NULL.
+static const char *json_field(const char *line, const char *key) {
+    char *pattern = g_strdup_printf("\"%s\": ", key);
+    const char *at = strstr(line, pattern);
+    if (at) at += strlen(pattern);
+    g_free(pattern);
+    return at;
+}
+
+static gboolean load_baseline(const char *path) {
+    char *contents;
+    if (!g_file_get_contents(path, &contents, NULL, NULL)) return FALSE;
+    baseline = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    char **lines = g_strsplit(contents, "\n", -1);
+    for (char **line = lines; *line; line++) {
+        const char *op = json_field(*line, "op");
+        const char *records = json_field(*line, "records");
+        const char *p50 = json_field(*line, "p50_ms");
+        if (!op || *op != '"' || !records || !p50) continue;
+        const char *op_end = strchr(op + 1, '"');
+        if (!op_end) continue;
+        char *key = g_strdup_printf("%.*s@%d", (int)(op_end - op - 1), op + 1, atoi(records));
+        double *value = g_new(double, 1);
+        *value = g_ascii_strtod(p50, NULL);
+        g_hash_table_replace(baseline, key, value);
+    }
+    g_strfreev(lines);
+    g_free(contents);
+    return TRUE;
+}
+
+// ================== OPERATIONS ==================
+
+// Wait until every queued write is on disk, delivering the writer's
+// results as the window's main loop would.
+static void bench_flush() {
+    do {
+        persist_shutdown();
+        while (g_main_context_iteration(NULL, FALSE));
+    } while (persist_pending > 0);
+    if (persist_failed) {
+        g_printerr("Error: could not save %s\n", FILE_NAME);
+        exit(1);
+    }
+}
+
+// Back to an empty store with empty dictionaries and indexes.
+static void bench_reset() {
+    bench_flush();
+    for (int key = 0; key < SORT_KEYS; key++) {
+        if (sort_orders[key]) g_array_unref(sort_orders[key]);
+        sort_orders[key] = NULL;
+    }
+    sort_active = -1;
+    store_clear(&store);
+    for (int f = 0; f < DICT_FIELDS; f++) dict_reset(f);
+    reg_index_rebuild();
+    search_index_rebuild();
+    columns_rebuild();
+    stats_rebuild();
+}
+
+static void bench_remove_files() {
+    const char *files[] = { FILE_NAME, FILE_NAME ".prev", FILE_NAME ".tmp",
+                            JOURNAL_FILE_NAME, JOURNAL_FILE_NAME ".old" };
+    for (guint i = 0; i < G_N_ELEMENTS(files); i++) g_unlink(files[i]);
+}
+
+// Rows refresh_table hands the model for filter: matching ids in name order.
+static void model_rebuild(const char *filter) {
+    char *error = NULL;
+    GArray *rows = search_students(filter, &error);
+    for (guint i = 0; i < rows->len; i++) {
+        g_array_index(rows, int, i) = store.records[g_array_index(rows, int, i)].id;
+    }
+    sort_rows(rows, SORT_NAME, FALSE);
+    bench_sink += rows->len;
+    g_array_unref(rows);
+    g_free(error);
+}
+
+static void update_statistics() {
+    if (store_count(&store) == 0) return;
+    bench_sink += stats_mean() + stats_min() + stats_max() + stats_stddev();
+    bench_sink += stats_percentile(0.25) + stats_percentile(0.5) + stats_percentile(0.75) + stats_percentile(0.9);
+}
+
+// A live id picked at random, or -1 if the store is empty.
+static int random_live_id(GRand *rng) {
+    int count = store_count(&store);
+    if (count == 0) return -1;
+    return store_get(&store, store_slot_at(&store, g_rand_int_range(rng, 0, count)))->id;
+}
+
+static void bench_size(int n) {
+    GRand *rng = g_rand_new_with_seed(opt_seed);
+    bench_reset();
+    bench_remove_files();
+    Student *students = g_new(Student, MAX(n, 1));
+    intern_choices();
+    generate_students(rng, 0, n, students);
+
+    BenchResult *r = result_new("insert", "records/s", n, n);
+    for (int run = 0; run < opt_runs; run++) {
+        if (run > 0) {
+            bench_reset();
+            intern_choices();
+        }
+        gint64 start = bench_now_ns();
+        store_insert_batch(&store, students, n);
+        result_add(r, start);
+    }
+    result_report(r);
+    g_free(students);
+
+    r = result_new("save", "records/s", n, n);
+    for (int run = 0; run < opt_runs; run++) {
+        gint64 start = bench_now_ns();
+        save_data();
+        bench_flush();
+        result_add(r, start);
+    }
+    result_report(r);
+
+    r = result_new("load", "records/s", n, n);
+    for (int run = 0; run < opt_runs; run++) {
+        bench_reset();
+        gint64 start = bench_now_ns();
+        load_data();
+        result_add(r, start);
+    }
+    result_report(r);
+    bench_flush();
+
+    static const struct { const char *op; SortKey key; } sorts[] = {
+        { "sort:name", SORT_NAME }, { "sort:reg", SORT_REG },
+        { "sort:branch", SORT_BRANCH }, { "sort:gpa", SORT_GPA }
+    };
+    for (guint i = 0; i < G_N_ELEMENTS(sorts); i++) {
+        r = result_new(sorts[i].op, "records/s", n, n);
+        for (int run = 0; run < opt_runs; run++) {
+            gint64 start = bench_now_ns();
+            GArray *order = sort_build(sorts[i].key);
+            result_add(r, start);
+            g_array_unref(order);
+        }
+        result_report(r);
+    }
+    sort_orders[SORT_NAME] = sort_build(SORT_NAME);
+
+    static const struct { const char *op; const char *query; } searches[] = {
+        { "search:text", "kumar" },
+        { "search:reg", "P24GPTC" },
+        { "search:filter", "branch=CSE gpa>=8" },
+        { "search:compound", "branch=CSE,IT gender=Female age<21 m3>60" }
+    };
+    int samples = bench_samples(n);
+    for (guint i = 0; i < G_N_ELEMENTS(searches); i++) {
+        r = result_new(searches[i].op, "ops/s", n, 1);
+        for (int k = 0; k < samples; k++) {
+            char *error = NULL;
+            gint64 start = bench_now_ns();
+            GArray *rows = search_students(searches[i].query, &error);
+            result_add(r, start);
+            bench_sink += rows->len;
+            g_array_unref(rows);
+            g_free(error);
+        }
+        result_report(r);
+    }
+
+    r = result_new("model_rebuild", "ops/s", n, 1);
+    for (int k = 0; k < samples; k++) {
+        gint64 start = bench_now_ns();
+        model_rebuild("branch=CSE");
+        result_add(r, start);
+    }
+    result_report(r);
+
+    r = result_new("stats", "ops/s", n, 1);
+    for (int k = 0; k < opt_samples; k++) {
+        gint64 start = bench_now_ns();
+        update_statistics();
+        result_add(r, start);
+    }
+    result_report(r);
+
+    r = result_new("analytics", "records/s", n, n);
+    for (int k = 0; k < samples; k++) {
+        gint64 start = bench_now_ns();
+        analytics_compute();
+        result_add(r, start);
+    }
+    result_report(r);
+
+    // Single-record changes, each with its journal entry queued
+    int changes = MIN(opt_samples * 5, n / 4);
+    if (changes > 0) {
+        Student edited;
+        r = result_new("edit", "ops/s", n, 1);
+        for (int k = 0; k < changes; k++) {
+            int id = random_live_id(rng);
+            edited = *store_lookup(&store, id);
+            edited.gpa = (float)g_rand_int_range(rng, 0, 1001) / 100.0f;
+            gint64 start = bench_now_ns();
+            if (store_update(&store, id, &edited)) journal_append(JOURNAL_OP_UPDATE, id, &edited);
+            result_add(r, start);
+        }
+        result_report(r);
+
+        // Only the search is timed; it pays for whatever the edit left stale
+        r = result_new("search:edited", "ops/s", n, 1);
+        for (int k = 0; k < samples; k++) {
+            int id = random_live_id(rng);
+            edited = *store_lookup(&store, id);
+            g_strlcpy(edited.name, store_lookup(&store, random_live_id(rng))->name, sizeof(edited.name));
+            if (store_update(&store, id, &edited)) journal_append(JOURNAL_OP_UPDATE, id, &edited);
+
+            char *error = NULL;
+            gint64 start = bench_now_ns();
+            GArray *rows = search_students("kumar", &error);
+            result_add(r, start);
+            bench_sink += rows->len;
+            g_array_unref(rows);
+            g_free(error);
+        }
+        result_report(r);
+
+        r = result_new("delete", "ops/s", n, 1);
+        for (int k = 0; k < changes; k++) {
+            int id = random_live_id(rng);
+            gint64 start = bench_now_ns();
+            if (store_remove(&store, id) >= 0) journal_append(JOURNAL_OP_DELETE, id, NULL);
+            result_add(r, start);
+        }
+        result_report(r);
+    }
+
+    bench_flush();
+    g_rand_free(rng);
+}
+
+// ================== MAIN ==================
+
+static int compare_int(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+// "1k,10k,100k,1m" -> ascending sizes
+static GArray *parse_sizes(const char *text) {
+    GArray *sizes = g_array_new(FALSE, FALSE, sizeof(int));
+    char **items = g_strsplit(text, ",", -1);
+    for (char **item = items; *item; item++) {
+        char *end;
+        double value = g_ascii_strtod(*item, &end);
+        if (*end == 'k' || *end == 'K') value *= 1e3, end++;
+        else if (*end == 'm' || *end == 'M') value *= 1e6, end++;
+        if (*end != '\0' || value < 1 || value > BENCH_REG_SPACE) {
+            g_printerr("Error: bad size %s\n", *item);
+            g_array_unref(sizes);
+            sizes = NULL;
+            break;
+        }
+        int n = (int)value;
+        g_array_append_val(sizes, n);
+    }
+    g_strfreev(items);
+    if (sizes) g_array_sort(sizes, compare_int);
+    return sizes;
+}
+
+int main(int argc, char **argv) {
+    GOptionEntry entries[] = {
+        { "sizes", 0, 0, G_OPTION_ARG_STRING, &opt_sizes, "Store sizes (default 1k,10k,100k,1m)", "LIST" },
+        { "runs", 0, 0, G_OPTION_ARG_INT, &opt_runs, "Runs of whole-store operations (default 5)", "N" },
+        { "samples", 0, 0, G_OPTION_ARG_INT, &opt_samples, "Most samples of quick operations (default 200)", "N" },
+        { "seed", 0, 0, G_OPTION_ARG_INT, &opt_seed, "Generator seed (default 42)", "N" },
+        { "json", 0, 0, G_OPTION_ARG_FILENAME, &opt_json, "Write results as JSON lines", "FILE" },
+        { "baseline", 0, 0, G_OPTION_ARG_FILENAME, &opt_baseline, "Compare with an earlier --json file", "FILE" },
+        { "threshold", 0, 0, G_OPTION_ARG_DOUBLE, &opt_threshold, "Slowdown in percent that fails (default 10)", "PCT" },
+        { "dir", 0, 0, G_OPTION_ARG_FILENAME, &opt_dir, "Run in DIR instead of a scratch directory", "DIR" },
+        { NULL }
+    };
+    GOptionContext *context = g_option_context_new("- time the student record engine");
+    g_option_context_add_main_entries(context, entries, NULL);
+    GError *error = NULL;
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("Error: %s\n", error->message);
+        return 2;
+    }
+    g_option_context_free(context);
+    opt_runs = MAX(opt_runs, 1);
+    opt_samples = MAX(opt_samples, 1);
+
+    GArray *sizes = parse_sizes(opt_sizes ? opt_sizes : "1k,10k,100k,1m");
+    if (!sizes) return 2;
+    if (opt_baseline && !load_baseline(opt_baseline)) {
+        g_printerr("Error: cannot read %s\n", opt_baseline);
+        return 2;
+    }
+    if (opt_json && !(json_fp = fopen(opt_json, "w"))) {
+        g_printerr("Error: cannot write %s\n", opt_json);
+        return 2;
+    }
+
+    char *dir = opt_dir ? g_strdup(opt_dir) : g_dir_make_tmp("students-bench-XXXXXX", NULL);
+    char *cwd = g_get_current_dir();
+    if (!dir || g_chdir(dir) != 0) {
+        g_printerr("Error: cannot use %s\n", dir ? dir : "a scratch directory");
+        return 2;
+    }
+
+    g_print("%-16s %9s %6s %10s %10s %10s %10s %14s %-9s %11s\n", "op", "records", "n", "p50 ms",
+            "p90 ms", "p99 ms", "max ms", "throughput", "", "peak rss");
+    for (guint i = 0; i < sizes->len; i++) bench_size(g_array_index(sizes, int, i));
+
+    bench_reset();
+    bench_remove_files();
+    g_chdir(cwd);
+    if (!opt_dir) g_rmdir(dir);
+    g_free(cwd);
+    g_free(dir);
+    g_array_unref(sizes);
+    if (json_fp) fclose(json_fp);
+    if (regressions > 0) {
+        g_printerr("%d results slower than the baseline by more than %.0f%%\n", regressions, opt_threshold);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,248 @@
+#include "cli.h"
+#include <string.h>
+
+// ================== COMMAND LINE ==================
+
+// Subcommands run against students.dat and the journal through the same
+// store, indexes and writer thread as the window, without starting GTK:
+//
+//   students query [--sort KEY] [--desc] [--json] [FILTER...]
+//   students import FILE.csv
+//   students export FILE [--format csv|json|marksheet]
+//   students stats
+//   students compact
+//   students verify
+//
+// Each exits 0 on success, 1 on failure and 2 on bad usage.
+
+static const char *const cli_sort_keys[SORT_KEYS] = {
+    "name", "reg", "branch", "program", "gender", "phone", "age", "gpa"
+};
+
+static int cli_usage() {
+    g_printerr("Usage: students [COMMAND]\n"
+               "With no command, opens the window.\n\n"
+               "  query [--sort KEY] [--desc] [--json] [FILTER...]\n"
+               "                        print matching students, or all without a FILTER\n"
+               "  import FILE.csv       add students from a CSV file\n"
+               "  export FILE [--format csv|json|marksheet]\n"
+               "                        write every student to FILE\n"
+               "  stats                 print GPA statistics and branch counts\n"
+               "  compact               fold the journal into a fresh snapshot\n"
+               "  verify                check students.dat and the journal\n");
+    return 2;
+}
+
+// Wait for every queued write. There is no main loop to deliver the
+// writer's results, so they are dispatched here, including any snapshot a
+// failed journal write falls back to.
+static gboolean cli_flush() {
+    do {
+        persist_shutdown();
+        while (g_main_context_iteration(NULL, FALSE));
+    } while (persist_pending > 0);
+    if (persist_failed) g_printerr("Error: could not save %s\n", FILE_NAME);
+    return !persist_failed;
+}
+
+static int cli_query(int argc, char **argv) {
+    int key = -1;
+    gboolean descending = FALSE, json = FALSE;
+    GString *filter = g_string_new(NULL);
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--sort") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            for (key = 0; key < SORT_KEYS && strcmp(cli_sort_keys[key], name) != 0; key++);
+            if (key == SORT_KEYS) {
+                g_printerr("Error: cannot sort by %s\n", name);
+                g_string_free(filter, TRUE);
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--desc") == 0) {
+            descending = TRUE;
+        } else if (strcmp(argv[i], "--json") == 0) {
+            json = TRUE;
+        } else {
+            if (filter->len) g_string_append_c(filter, ' ');
+            g_string_append(filter, argv[i]);
+        }
+    }
+
+    load_data();
+    GArray *rows;
+    if (filter->str[strspn(filter->str, " \t")] == '\0') {
+        // No filter lists everyone, as an empty search box does
+        rows = g_array_sized_new(FALSE, FALSE, sizeof(int), MAX(store_count(&store), 1));
+        for (int slot = 0; slot < store_slots(&store); slot++) {
+            if (store_is_live(&store, slot)) g_array_append_val(rows, store.records[slot].id);
+        }
+    } else {
+        char *error = NULL;
+        rows = search_students(filter->str, &error);
+        if (error) {
+            g_printerr("Error: %s\n", error);
+            g_free(error);
+            g_array_unref(rows);
+            g_string_free(filter, TRUE);
+            cli_flush();
+            return 2;
+        }
+        for (guint i = 0; i < rows->len; i++) {
+            g_array_index(rows, int, i) = store.records[g_array_index(rows, int, i)].id;
+        }
+    }
+    g_string_free(filter, TRUE);
+    if (key >= 0) {
+        sort_orders[key] = sort_build(key);
+        sort_rows(rows, key, descending);
+    } else if (descending) {
+        for (guint i = 0; i < rows->len / 2; i++) {
+            int t = g_array_index(rows, int, i);
+            g_array_index(rows, int, i) = g_array_index(rows, int, rows->len - 1 - i);
+            g_array_index(rows, int, rows->len - 1 - i) = t;
+        }
+    }
+
+    export_ids(stdout, rows, json ? EXPORT_JSON : EXPORT_CSV);
+    g_array_unref(rows);
+    return cli_flush() ? 0 : 1;
+}
+
+static int cli_export(int argc, char **argv) {
+    const char *path = NULL, *format = NULL;
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) format = argv[++i];
+        else if (!path) path = argv[i];
+        else return cli_usage();
+    }
+    if (!path) return cli_usage();
+
+    ExportJob *job = export_job_new(path, export_format_for_path(path));
+    if (format) {
+        if (strcmp(format, "csv") == 0) job->format = EXPORT_CSV;
+        else if (strcmp(format, "json") == 0) job->format = EXPORT_JSON;
+        else if (strcmp(format, "marksheet") == 0) job->format = EXPORT_MARKSHEET;
+        else {
+            export_job_free(job);
+            return cli_usage();
+        }
+    }
+
+    load_data();
+    char *error = NULL;
+    gboolean ok = export_students(job, NULL, &error);
+    if (ok) g_print("Exported %d students to %s\n", job->exported, path);
+    else g_printerr("Error: %s\n", error);
+    g_free(error);
+    export_job_free(job);
+    return cli_flush() && ok ? 0 : 1;
+}
+
+static int cli_stats() {
+    load_data();
+    int count = store_count(&store);
+    g_print("students        %d\n", count);
+    if (count > 0) {
+        g_print("gpa mean        %.2f\n", stats_mean());
+        g_print("gpa std dev     %.2f\n", stats_stddev());
+        g_print("gpa min         %.2f\n", stats_min());
+        g_print("gpa 25th        %.2f\n", stats_percentile(0.25));
+        g_print("gpa median      %.2f\n", stats_percentile(0.5));
+        g_print("gpa 75th        %.2f\n", stats_percentile(0.75));
+        g_print("gpa 90th        %.2f\n", stats_percentile(0.9));
+        g_print("gpa max         %.2f\n", stats_max());
+    }
+
+    int *per_branch = g_new0(int, dict_size(DICT_BRANCH));
+    for (int i = 0; i < store_slots(&store); i++) {
+        if (store_is_live(&store, i)) per_branch[store.records[i].branch]++;
+    }
+    for (int code = 0; code < dict_size(DICT_BRANCH); code++) {
+        if (per_branch[code] == 0) continue;
+        const char *branch = dict_name(DICT_BRANCH, code);
+        g_print("branch %-8s %d\n", *branch ? branch : "(none)", per_branch[code]);
+    }
+    g_free(per_branch);
+    return cli_flush() ? 0 : 1;
+}
+
+static int cli_compact() {
+    load_data();
+    save_data();
+    if (!cli_flush()) return 1;
+    g_print("%s: %d students, journal folded\n", FILE_NAME, store_count(&store));
+    return 0;
+}
+
+// Report on the files as they are, before load_data repairs anything.
+static int cli_verify() {
+    gboolean ok = TRUE;
+    FileHeader header;
+    gint64 bad;
+    FileLayout layout = file_check(FILE_NAME, &header, &bad);
+    switch (layout) {
+    case FILE_LAYOUT_NATIVE:
+    case FILE_LAYOUT_FOREIGN:
+        g_print("%s: version %u, %u students, seq %" G_GUINT64_FORMAT "%s\n", FILE_NAME, header.version,
+                header.record_count, header.seq, layout == FILE_LAYOUT_FOREIGN ? ", converted on load" : "");
+        if (bad >= 0) {
+            g_print("%s: block %" G_GINT64_FORMAT " failed its checksum\n", FILE_NAME, bad);
+            ok = FALSE;
+        }
+        break;
+    case FILE_LAYOUT_LEGACY:
+        g_print("%s: legacy format, upgraded on load\n", FILE_NAME);
+        break;
+    case FILE_LAYOUT_EMPTY:
+        g_print("%s: %s\n", FILE_NAME, g_file_test(FILE_NAME, G_FILE_TEST_EXISTS) ? "empty" : "missing");
+        break;
+    default:
+        g_print("%s: damaged or from a newer version\n", FILE_NAME);
+        ok = FALSE;
+        break;
+    }
+
+    const char *journals[] = { JOURNAL_FILE_NAME, JOURNAL_FILE_NAME ".old" };
+    for (int i = 0; i < 2; i++) {
+        if (!g_file_test(journals[i], G_FILE_TEST_EXISTS)) continue;
+        int entries;
+        gboolean clean = journal_verify(journals[i], &entries);
+        g_print("%s: %d entries%s\n", journals[i], entries, clean ? "" : ", then a torn or damaged entry");
+        ok = ok && clean;
+    }
+    if (g_file_test(FILE_NAME ".prev", G_FILE_TEST_EXISTS)) {
+        g_print("%s: previous generation kept\n", FILE_NAME ".prev");
+    }
+    return ok ? 0 : 1;
+}
+
+gboolean cli_is_command(const char *arg) {
+    const char *commands[] = {"query", "import", "--import", "export", "stats", "compact", "verify",
+                              "help", "--help", "-h", NULL};
+    return g_strv_contains(commands, arg);
+}
+
+int cli_main(int argc, char **argv) {
+    const char *command = argv[1];
+    argc -= 2;
+    argv += 2;
+
+    if (strcmp(command, "help") == 0 || strcmp(command, "--help") == 0 || strcmp(command, "-h") == 0) {
+        cli_usage();
+        return 0;
+    }
+
+    if (strcmp(command, "query") == 0) return cli_query(argc, argv);
+    if (strcmp(command, "export") == 0) return cli_export(argc, argv);
+    if (strcmp(command, "import") == 0 || strcmp(command, "--import") == 0) {
+        if (argc != 1) return cli_usage();
+        load_data();
+        int status = import_file(argv[0]);
+        return cli_flush() ? status : 1;
+    }
+    if (argc != 0) return cli_usage();
+    if (strcmp(command, "stats") == 0) return cli_stats();
+    if (strcmp(command, "compact") == 0) return cli_compact();
+    if (strcmp(command, "verify") == 0) return cli_verify();
+    return cli_usage();
+}
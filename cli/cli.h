@@ -0,0 +1,14 @@
+// Headless subcommands shared by the window's binary and students-cli.
+
+#ifndef STUDENTS_CLI_H
+#define STUDENTS_CLI_H
+
+#include "students.h"
+
+// Whether arg names a subcommand rather than a GTK option.
+gboolean cli_is_command(const char *arg);
+
+// Run the subcommand in argv[1]; returns the process exit status.
+int cli_main(int argc, char **argv);
+
+#endif
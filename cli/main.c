@@ -0,0 +1,15 @@
+// students-cli: the subcommands without linking GTK.
+
+#include "cli.h"
+
+int main(int argc, char **argv) {
+    if (argc < 2 || !cli_is_command(argv[1])) {
+        char *help[] = { argv[0], "help", NULL };
+        cli_main(2, help);
+        return 2;
+    }
+    trace_start_from_env();
+    int status = cli_main(argc, argv);
+    trace_finish();
+    return status;
+}
@@ -0,0 +1,155 @@
+#include "internal.h"
+
+// ================== STRING DICTIONARIES ==================
+
+// Interned strings for the low-cardinality Student fields. A string's code
+// is its position in names and never changes, so records, the shadow
+// columns, snapshots and the journal can all hold the code. Strings are
+// never removed; a dictionary only grows until the next load.
+
+typedef struct {
+    GHashTable *codes;   // String -> code + 1
+    GPtrArray *names;    // Code -> string
+} StringDict;
+
+StringDict dicts[DICT_FIELDS];
+GRWLock dict_lock;  // Held to add strings; other threads read under it
+
+static void dict_append(StringDict *d, const char *s) {
+    char *name = g_strdup(s);
+    g_rw_lock_writer_lock(&dict_lock);
+    g_ptr_array_add(d->names, name);
+    if (!g_hash_table_contains(d->codes, name)) {
+        g_hash_table_insert(d->codes, name, GUINT_TO_POINTER(d->names->len));
+    }
+    g_rw_lock_writer_unlock(&dict_lock);
+}
+
+// Drop every string, leaving only code 0.
+void dict_reset(DictField field) {
+    StringDict *d = &dicts[field];
+    if (d->codes) g_hash_table_destroy(d->codes);
+    if (d->names) g_ptr_array_free(d->names, TRUE);
+    d->codes = g_hash_table_new(g_str_hash, g_str_equal);
+    d->names = g_ptr_array_new_with_free_func(g_free);
+    dict_append(d, "");
+}
+
+// Code for s, adding it if it is new, or DICT_FULL if it is new and the
+// dictionary has no codes left. Strings are cut to DICT_MAX_LENGTH - 1
+// bytes on a UTF-8 boundary.
+guint16 dict_intern(DictField field, const char *s) {
+    StringDict *d = &dicts[field];
+    if (!d->names) dict_reset(field);
+
+    char cut[DICT_MAX_LENGTH];
+    gsize len = strlen(s);
+    if (len >= sizeof(cut)) {
+        len = sizeof(cut) - 1;
+        while (len > 0 && (s[len] & 0xC0) == 0x80) len--;
+        memcpy(cut, s, len);
+        cut[len] = '\0';
+        s = cut;
+    }
+
+    gpointer code = g_hash_table_lookup(d->codes, s);
+    if (code) return GPOINTER_TO_UINT(code) - 1;
+    if (d->names->len >= DICT_FULL) return DICT_FULL;
+
+    dict_append(d, s);
+    return d->names->len - 1;
+}
+
+// dict_intern for a fixed-size char field that may lack its terminator.
+guint16 dict_intern_chars(DictField field, const char *chars, gsize size) {
+    gsize len = strnlen(chars, size);
+    if (len >= DICT_MAX_LENGTH) {
+        char *s = g_strndup(chars, len);
+        guint16 code = dict_intern(field, s);
+        g_free(s);
+        return code;
+    }
+    char buf[DICT_MAX_LENGTH];
+    memcpy(buf, chars, len);
+    buf[len] = '\0';
+    return dict_intern(field, buf);
+}
+
+const char *dict_name(DictField field, guint16 code) {
+    const StringDict *d = &dicts[field];
+    return d->names && code < d->names->len ? g_ptr_array_index(d->names, code) : "";
+}
+
+int dict_size(DictField field) {
+    return dicts[field].names ? (int)dicts[field].names->len : 1;
+}
+
+// Append s as the next code, as replaying the journal requires, even if an
+// equal string already has one.
+void dict_push(DictField field, const char *s) {
+    if (!dicts[field].names) dict_reset(field);
+    dict_append(&dicts[field], s);
+}
+
+// Replace a dictionary with strings loaded from disk, keeping their codes.
+void dict_load(DictField field, const char *const *strings, int count) {
+    StringDict *d = &dicts[field];
+    dict_reset(field);
+    if (count == 0) return;
+    g_ptr_array_set_size(d->names, 0);
+    g_hash_table_remove_all(d->codes);
+    for (int i = 0; i < count; i++) dict_append(d, strings[i]);
+}
+
+// Copy of a dictionary's strings in code order, for writing off-thread.
+GPtrArray *dict_copy(DictField field) {
+    GPtrArray *copy = g_ptr_array_new_with_free_func(g_free);
+    for (int code = 0; code < dict_size(field); code++) {
+        g_ptr_array_add(copy, g_strdup(dict_name(field, code)));
+    }
+    return copy;
+}
+
+// FALSE if any of the student's names got DICT_FULL instead of a code.
+gboolean student_codes_valid(const Student *student) {
+    if (student->branch == DICT_FULL || student->program == DICT_FULL || student->gender == DICT_FULL) {
+        return FALSE;
+    }
+    for (int j = 0; j < 6; j++) {
+        if (student->subjects[j].subject_name == DICT_FULL) return FALSE;
+    }
+    return TRUE;
+}
+
+// Returns FALSE if a name did not fit its dictionary.
+gboolean student_from_v1(const StudentV1 *in, Student *out) {
+    memset(out, 0, sizeof(*out));
+    out->id = in->id;
+    memcpy(out->name, in->name, sizeof(out->name));
+    memcpy(out->reg_num, in->reg_num, sizeof(out->reg_num));
+    memcpy(out->phone, in->phone, sizeof(out->phone));
+    out->name[sizeof(out->name) - 1] = '\0';
+    out->reg_num[sizeof(out->reg_num) - 1] = '\0';
+    out->phone[sizeof(out->phone) - 1] = '\0';
+    out->age = in->age;
+    out->gpa = in->gpa;
+
+    out->branch = dict_intern_chars(DICT_BRANCH, in->branch, sizeof(in->branch));
+    out->program = dict_intern_chars(DICT_PROGRAM, in->program, sizeof(in->program));
+    out->gender = dict_intern_chars(DICT_GENDER, in->gender, sizeof(in->gender));
+    for (int j = 0; j < 6; j++) {
+        out->subjects[j].subject_name = dict_intern_chars(DICT_SUBJECT, in->subjects[j].subject_name,
+                                                          sizeof(in->subjects[j].subject_name));
+        out->subjects[j].marks = in->subjects[j].marks;
+    }
+    return student_codes_valid(out);
+}
+
+char default_subject_names[6][50] = {
+    "Subject 1", "Subject 2", "Subject 3", "Subject 4", "Subject 5", "Subject 6"
+};
+
+// Choices offered by the add and edit forms, and accepted by CSV IMPORT
+const char *branch_choices[] = {"CSE", "IT", "ECE", "EEE", "Mechanical", "Civil", "Other", NULL};
+const char *program_choices[] = {"BTECH", "MBA", "DIPLOMA", NULL};
+const char *gender_choices[] = {"Male", "Female", "Other", NULL};
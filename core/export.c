@@ -0,0 +1,343 @@
+#include "internal.h"
+
+// ================== EXPORT ==================
+
+// Rosters (CSV or JSON) and per-student marksheets (plain text, one page
+// per student separated by form feeds, ready for a text-to-PDF step) are
+// streamed from the store on a worker thread. Records are visited in id
+// order, a chunk at a time under the store's read lock, so edits carry on
+// between chunks and every row is a consistent record. Each chunk is
+// formatted into one buffer by hand-rolled number and string writers that
+// never allocate, and written out with the lock released. Memory stays at
+// one chunk's worth whatever the size of the store.
+//
+// The file is written as path.part and renamed when complete.
+
+#define EXPORT_CHUNK_RECORDS 4096
+#define EXPORT_BUFFER_SIZE (1 << 20)
+#define EXPORT_PAGE_WIDTH 48  // Marksheet columns
+
+typedef struct {
+    char *data;
+    gsize len, cap;
+} ExportBuffer;
+
+static inline char *export_reserve(ExportBuffer *b, gsize n) {
+    if (b->len + n > b->cap) {
+        b->cap = MAX(b->cap * 2, b->len + n);
+        b->data = g_realloc(b->data, b->cap);
+    }
+    return b->data + b->len;
+}
+
+static inline void export_put(ExportBuffer *b, const char *s, gsize n) {
+    memcpy(export_reserve(b, n), s, n);
+    b->len += n;
+}
+
+#define EXPORT_PUT(b, literal) export_put((b), (literal), sizeof(literal) - 1)
+
+static inline void export_put_char(ExportBuffer *b, char c) {
+    *export_reserve(b, 1) = c;
+    b->len++;
+}
+
+static void export_put_int(ExportBuffer *b, gint64 value) {
+    char digits[24];
+    int n = 0;
+    guint64 v = value < 0 ? -(guint64)value : (guint64)value;
+    do {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    if (value < 0) export_put_char(b, '-');
+    char *out = export_reserve(b, n);
+    for (int i = 0; i < n; i++) out[i] = digits[n - 1 - i];
+    b->len += n;
+}
+
+// value with two decimals, as the forms show GPAs and marks.
+static void export_put_fixed2(ExportBuffer *b, double value) {
+    gint64 cents = (gint64)llround(value * 100.0);
+    if (cents < 0) {
+        export_put_char(b, '-');
+        cents = -cents;
+    }
+    export_put_int(b, cents / 100);
+    char *out = export_reserve(b, 3);
+    out[0] = '.';
+    out[1] = '0' + cents % 100 / 10;
+    out[2] = '0' + cents % 10;
+    b->len += 3;
+}
+
+static void export_put_csv(ExportBuffer *b, const char *s) {
+    if (!s[strcspn(s, ",\"\r\n")]) {
+        export_put(b, s, strlen(s));
+        return;
+    }
+    export_put_char(b, '"');
+    for (; *s; s++) {
+        if (*s == '"') export_put_char(b, '"');
+        export_put_char(b, *s);
+    }
+    export_put_char(b, '"');
+}
+
+static void export_put_json(ExportBuffer *b, const char *s) {
+    static const char hex[] = "0123456789abcdef";
+    export_put_char(b, '"');
+    for (; *s; s++) {
+        guchar c = *s;
+        if (c == '"' || c == '\\') {
+            export_put_char(b, '\\');
+            export_put_char(b, c);
+        } else if (c < 0x20) {
+            char *out = export_reserve(b, 6);
+            memcpy(out, "\\u00", 4);
+            out[4] = hex[c >> 4];
+            out[5] = hex[c & 15];
+            b->len += 6;
+        } else {
+            export_put_char(b, c);
+        }
+    }
+    export_put_char(b, '"');
+}
+
+// s followed by spaces up to width characters.
+static void export_put_padded(ExportBuffer *b, const char *s, int width) {
+    export_put(b, s, strlen(s));
+    for (long n = g_utf8_strlen(s, -1); n < width; n++) export_put_char(b, ' ');
+}
+
+// value right-aligned so it ends at the page's last column.
+static void export_put_amount(ExportBuffer *b, const char *label, double value) {
+    export_put_padded(b, label, EXPORT_PAGE_WIDTH - 10);
+    gsize start = b->len;
+    export_put_fixed2(b, value);
+    gsize width = b->len - start;
+    if (width < 10) {
+        export_reserve(b, 10 - width);
+        memmove(b->data + start + 10 - width, b->data + start, width);
+        memset(b->data + start, ' ', 10 - width);
+        b->len += 10 - width;
+    }
+    export_put_char(b, '\n');
+}
+
+static void export_put_rule(ExportBuffer *b) {
+    for (int i = 0; i < EXPORT_PAGE_WIDTH; i++) export_put_char(b, '-');
+    export_put_char(b, '\n');
+}
+
+static void export_csv_header(ExportBuffer *b) {
+    EXPORT_PUT(b, "Reg No,Name,Branch,Program,Gender,Phone,Age,GPA");
+    for (int j = 1; j <= 6; j++) {
+        EXPORT_PUT(b, ",Subject ");
+        export_put_int(b, j);
+        EXPORT_PUT(b, ",Marks ");
+        export_put_int(b, j);
+    }
+    EXPORT_PUT(b, "\r\n");
+}
+
+static void export_csv_row(ExportBuffer *b, const Student *s) {
+    export_put_csv(b, s->reg_num);
+    export_put_char(b, ',');
+    export_put_csv(b, s->name);
+    export_put_char(b, ',');
+    export_put_csv(b, dict_name(DICT_BRANCH, s->branch));
+    export_put_char(b, ',');
+    export_put_csv(b, dict_name(DICT_PROGRAM, s->program));
+    export_put_char(b, ',');
+    export_put_csv(b, dict_name(DICT_GENDER, s->gender));
+    export_put_char(b, ',');
+    export_put_csv(b, s->phone);
+    export_put_char(b, ',');
+    export_put_int(b, s->age);
+    export_put_char(b, ',');
+    export_put_fixed2(b, s->gpa);
+    for (int j = 0; j < 6; j++) {
+        export_put_char(b, ',');
+        export_put_csv(b, dict_name(DICT_SUBJECT, s->subjects[j].subject_name));
+        export_put_char(b, ',');
+        export_put_fixed2(b, s->subjects[j].marks);
+    }
+    EXPORT_PUT(b, "\r\n");
+}
+
+static void export_json_row(ExportBuffer *b, const Student *s, gboolean first) {
+    if (!first) export_put_char(b, ',');
+    EXPORT_PUT(b, "\n  {\"id\": ");
+    export_put_int(b, s->id);
+    EXPORT_PUT(b, ", \"reg_num\": ");
+    export_put_json(b, s->reg_num);
+    EXPORT_PUT(b, ", \"name\": ");
+    export_put_json(b, s->name);
+    EXPORT_PUT(b, ", \"branch\": ");
+    export_put_json(b, dict_name(DICT_BRANCH, s->branch));
+    EXPORT_PUT(b, ", \"program\": ");
+    export_put_json(b, dict_name(DICT_PROGRAM, s->program));
+    EXPORT_PUT(b, ", \"gender\": ");
+    export_put_json(b, dict_name(DICT_GENDER, s->gender));
+    EXPORT_PUT(b, ", \"phone\": ");
+    export_put_json(b, s->phone);
+    EXPORT_PUT(b, ", \"age\": ");
+    export_put_int(b, s->age);
+    EXPORT_PUT(b, ", \"gpa\": ");
+    export_put_fixed2(b, s->gpa);
+    EXPORT_PUT(b, ", \"subjects\": [");
+    for (int j = 0; j < 6; j++) {
+        if (j) EXPORT_PUT(b, ", ");
+        EXPORT_PUT(b, "{\"name\": ");
+        export_put_json(b, dict_name(DICT_SUBJECT, s->subjects[j].subject_name));
+        EXPORT_PUT(b, ", \"marks\": ");
+        export_put_fixed2(b, s->subjects[j].marks);
+        export_put_char(b, '}');
+    }
+    EXPORT_PUT(b, "]}");
+}
+
+static void export_marksheet(ExportBuffer *b, const Student *s, gboolean first) {
+    if (!first) export_put_char(b, '\f');
+    EXPORT_PUT(b, "STUDENT MARKSHEET\n\n");
+    EXPORT_PUT(b, "Name:     ");
+    export_put(b, s->name, strlen(s->name));
+    EXPORT_PUT(b, "\nReg No:   ");
+    export_put(b, s->reg_num, strlen(s->reg_num));
+    EXPORT_PUT(b, "\nBranch:   ");
+    export_put_padded(b, dict_name(DICT_BRANCH, s->branch), 14);
+    EXPORT_PUT(b, "Program:  ");
+    const char *program = dict_name(DICT_PROGRAM, s->program);
+    export_put(b, program, strlen(program));
+    EXPORT_PUT(b, "\n\n");
+    export_put_rule(b);
+    export_put_padded(b, "Subject", EXPORT_PAGE_WIDTH - 5);
+    EXPORT_PUT(b, "Marks\n");
+    export_put_rule(b);
+    double total = 0.0;
+    for (int j = 0; j < 6; j++) {
+        export_put_amount(b, dict_name(DICT_SUBJECT, s->subjects[j].subject_name), s->subjects[j].marks);
+        total += s->subjects[j].marks;
+    }
+    export_put_rule(b);
+    export_put_amount(b, "Total", total);
+    export_put_amount(b, "Percentage", total / 6.0);
+    export_put_amount(b, "GPA", s->gpa);
+}
+
+// Which format a file name asks for: .json, .txt for marksheets, else CSV.
+ExportFormat export_format_for_path(const char *path) {
+    if (g_str_has_suffix(path, ".json")) return EXPORT_JSON;
+    if (g_str_has_suffix(path, ".txt")) return EXPORT_MARKSHEET;
+    return EXPORT_CSV;
+}
+
+// Stream every student to job->path. Safe on any thread; reads the store
+// and the dictionaries under their read locks a chunk at a time.
+gboolean export_students(ExportJob *job, GCancellable *cancellable, char **error) {
+    char *part = g_strconcat(job->path, ".part", NULL);
+    FILE *fp = fopen(part, "wb");
+    if (!fp) {
+        *error = g_strdup_printf("Could not create %s", part);
+        g_free(part);
+        return FALSE;
+    }
+
+    ExportBuffer b = { g_malloc(EXPORT_BUFFER_SIZE), 0, EXPORT_BUFFER_SIZE };
+    if (job->format == EXPORT_CSV) export_csv_header(&b);
+    if (job->format == EXPORT_JSON) export_put_char(&b, '[');
+
+    g_rw_lock_reader_lock(&store_lock);
+    int end_id = store.next_id;
+    int total = MAX(store_count(&store), 1);
+    g_rw_lock_reader_unlock(&store_lock);
+
+    gboolean ok = TRUE;
+    job->exported = 0;
+    for (int id = 1; ok && id < end_id; ) {
+        if (g_cancellable_is_cancelled(cancellable)) {
+            *error = g_strdup("Export cancelled");
+            ok = FALSE;
+            break;
+        }
+
+        g_rw_lock_reader_lock(&store_lock);
+        g_rw_lock_reader_lock(&dict_lock);
+        for (int last = MIN(id + EXPORT_CHUNK_RECORDS, end_id); id < last; id++) {
+            const Student *s = store_lookup(&store, id);
+            if (!s) continue;
+            switch (job->format) {
+            case EXPORT_CSV: export_csv_row(&b, s); break;
+            case EXPORT_JSON: export_json_row(&b, s, job->exported == 0); break;
+            case EXPORT_MARKSHEET: export_marksheet(&b, s, job->exported == 0); break;
+            }
+            job->exported++;
+        }
+        g_rw_lock_reader_unlock(&dict_lock);
+        g_rw_lock_reader_unlock(&store_lock);
+
+        ok = fwrite(b.data, 1, b.len, fp) == b.len;
+        b.len = 0;
+        g_atomic_int_set(&job->progress, MIN(1000, (int)((gint64)job->exported * 1000 / total)));
+    }
+    if (job->format == EXPORT_JSON) {
+        if (job->exported > 0) export_put_char(&b, '\n');
+        EXPORT_PUT(&b, "]\n");
+    }
+    ok = ok && fwrite(b.data, 1, b.len, fp) == b.len;
+
+    if (!(fclose(fp) == 0 && ok)) {
+        if (!*error) *error = g_strdup_printf("Could not write %s", part);
+        ok = FALSE;
+    }
+    if (ok && g_rename(part, job->path) != 0) {
+        *error = g_strdup_printf("Could not replace %s", job->path);
+        ok = FALSE;
+    }
+    if (!ok) g_unlink(part);
+    g_free(b.data);
+    g_free(part);
+    return ok;
+}
+
+// Write the students with the given ids to fp in the given order, as a
+// whole document. Main thread only.
+gboolean export_ids(FILE *fp, GArray *ids, ExportFormat format) {
+    gboolean ok = TRUE;
+    ExportBuffer b = { g_malloc(EXPORT_BUFFER_SIZE), 0, EXPORT_BUFFER_SIZE };
+    if (format == EXPORT_CSV) export_csv_header(&b);
+    if (format == EXPORT_JSON) export_put_char(&b, '[');
+    for (guint i = 0; i < ids->len; i++) {
+        const Student *s = store_lookup(&store, g_array_index(ids, int, i));
+        switch (format) {
+        case EXPORT_CSV: export_csv_row(&b, s); break;
+        case EXPORT_JSON: export_json_row(&b, s, i == 0); break;
+        case EXPORT_MARKSHEET: export_marksheet(&b, s, i == 0); break;
+        }
+        if (b.len >= EXPORT_BUFFER_SIZE / 2) {
+            ok = ok && fwrite(b.data, 1, b.len, fp) == b.len;
+            b.len = 0;
+        }
+    }
+    if (format == EXPORT_JSON) {
+        if (ids->len) export_put_char(&b, '\n');
+        EXPORT_PUT(&b, "]\n");
+    }
+    ok = ok && fwrite(b.data, 1, b.len, fp) == b.len;
+    g_free(b.data);
+    return ok;
+}
+
+ExportJob *export_job_new(const char *path, ExportFormat format) {
+    ExportJob *job = g_new0(ExportJob, 1);
+    job->path = g_strdup(path);
+    job->format = format;
+    return job;
+}
+
+void export_job_free(ExportJob *job) {
+    g_free(job->path);
+    g_free(job);
+}
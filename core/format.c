@@ -0,0 +1,521 @@
+#include "internal.h"
+
+// ================== ON-DISK FORMAT ==================
+
+// students.dat layout (format version 2):
+//
+//   FileHeader         64 bytes, written in the writer's native byte order
+//   FileField[n]       one entry per Student field: name, offset, size, type,
+//                      and for FIELD_CODE16 fields the dictionary it indexes
+//   dictionaries       guint32 count, then per dictionary a FileDictionary
+//                      followed by its NUL-terminated strings in code order
+//   padding            up to FILE_RECORD_ALIGN
+//   records            record_count * record_size bytes, contiguous so the
+//                      file can be mapped and read in place
+//   block CRCs         one CRC-32C per FILE_BLOCK_RECORDS records
+//
+// header_crc covers the header (with header_crc zeroed) and everything up to
+// the records. A reader whose Student layout, padding or byte order differs
+// from the writer's matches fields by name and converts each record, going
+// through the strings for coded fields, so the struct can evolve without
+// corrupting old files. Version 1 files (no dictionaries, header_crc over
+// the field table only, every string inline) convert the same way. Files
+// without the magic are the legacy raw dump (int count + StudentV1[count] +
+// optional SEQ1 trailer). Both are rewritten in this format on load.
+
+typedef struct {
+    guint32 count;      // Strings, code 0 first
+    guint32 bytes;      // Length of the strings including their NULs
+} FileDictionary;
+
+typedef enum {
+    FIELD_INT32 = 1,
+    FIELD_FLOAT32 = 2,
+    FIELD_CHARS = 3,
+    FIELD_CODE16 = 4    // guint16 dictionary code
+} FieldType;
+
+#define STUDENT_FIELD(name, member, type) \
+    { name, G_STRUCT_OFFSET(Student, member), sizeof(((Student *)0)->member), type, 0 }
+#define STUDENT_CODE_FIELD(name, member, dict) \
+    { name, G_STRUCT_OFFSET(Student, member), sizeof(guint16), FIELD_CODE16, dict }
+#define SUBJECT_FIELDS(n) \
+    STUDENT_CODE_FIELD("subject" #n "_name", subjects[n - 1].subject_name, DICT_SUBJECT), \
+    STUDENT_FIELD("subject" #n "_marks", subjects[n - 1].marks, FIELD_FLOAT32)
+
+static const FileField student_fields[] = {
+    STUDENT_FIELD("id", id, FIELD_INT32),
+    STUDENT_FIELD("name", name, FIELD_CHARS),
+    STUDENT_FIELD("reg_num", reg_num, FIELD_CHARS),
+    STUDENT_CODE_FIELD("branch", branch, DICT_BRANCH),
+    STUDENT_CODE_FIELD("program", program, DICT_PROGRAM),
+    STUDENT_CODE_FIELD("gender", gender, DICT_GENDER),
+    STUDENT_FIELD("phone", phone, FIELD_CHARS),
+    STUDENT_FIELD("age", age, FIELD_INT32),
+    STUDENT_FIELD("gpa", gpa, FIELD_FLOAT32),
+    SUBJECT_FIELDS(1), SUBJECT_FIELDS(2), SUBJECT_FIELDS(3),
+    SUBJECT_FIELDS(4), SUBJECT_FIELDS(5), SUBJECT_FIELDS(6),
+};
+
+#define N_STUDENT_FIELDS G_N_ELEMENTS(student_fields)
+
+// ---- CRC-32C (Castagnoli) ----
+// Uses the SSE4.2 / ARMv8 CRC instructions when the CPU has them (8 bytes
+// per instruction), otherwise a slicing-by-8 table walk.
+
+static guint32 crc32c_table[8][256];
+
+static void crc32c_init_table(void) {
+    for (guint32 i = 0; i < 256; i++) {
+        guint32 crc = i;
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1)));
+        }
+        crc32c_table[0][i] = crc;
+    }
+    for (guint32 i = 0; i < 256; i++) {
+        for (int t = 1; t < 8; t++) {
+            guint32 prev = crc32c_table[t - 1][i];
+            crc32c_table[t][i] = (prev >> 8) ^ crc32c_table[0][prev & 0xFF];
+        }
+    }
+}
+
+static guint32 crc32c_sw(guint32 crc, const guchar *p, gsize len) {
+    while (len >= 8) {
+        guint32 lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+#if G_BYTE_ORDER == G_BIG_ENDIAN
+        lo = GUINT32_SWAP_LE_BE(lo);
+        hi = GUINT32_SWAP_LE_BE(hi);
+#endif
+        lo ^= crc;
+        crc = crc32c_table[7][lo & 0xFF] ^ crc32c_table[6][(lo >> 8) & 0xFF] ^
+              crc32c_table[5][(lo >> 16) & 0xFF] ^ crc32c_table[4][lo >> 24] ^
+              crc32c_table[3][hi & 0xFF] ^ crc32c_table[2][(hi >> 8) & 0xFF] ^
+              crc32c_table[1][(hi >> 16) & 0xFF] ^ crc32c_table[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while (len--) {
+        crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *p++) & 0xFF];
+    }
+    return crc;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#define HAVE_CRC32C_HW 1
+
+__attribute__((target("sse4.2")))
+static guint32 crc32c_hw(guint32 crc, const guchar *p, gsize len) {
+    guint64 c = crc;
+    while (len >= 8) {
+        guint64 v;
+        memcpy(&v, p, 8);
+        c = _mm_crc32_u64(c, v);
+        p += 8;
+        len -= 8;
+    }
+    crc = (guint32)c;
+    while (len--) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+
+static gboolean crc32c_hw_available(void) {
+    return __builtin_cpu_supports("sse4.2");
+}
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define HAVE_CRC32C_HW 1
+
+static guint32 crc32c_hw(guint32 crc, const guchar *p, gsize len) {
+    while (len >= 8) {
+        guint64 v;
+        memcpy(&v, p, 8);
+        crc = __crc32cd(crc, v);
+        p += 8;
+        len -= 8;
+    }
+    while (len--) {
+        crc = __crc32cb(crc, *p++);
+    }
+    return crc;
+}
+
+static gboolean crc32c_hw_available(void) {
+    return TRUE;
+}
+#endif
+
+guint32 crc32c(guint32 crc, const void *data, gsize len) {
+    static gsize init = 0;
+    static gboolean use_hw = FALSE;
+
+    if (g_once_init_enter(&init)) {
+        crc32c_init_table();
+#ifdef HAVE_CRC32C_HW
+        use_hw = crc32c_hw_available();
+#endif
+        g_once_init_leave(&init, 1);
+    }
+
+    crc = ~crc;
+#ifdef HAVE_CRC32C_HW
+    if (use_hw) return ~crc32c_hw(crc, data, len);
+#endif
+    return ~crc32c_sw(crc, data, len);
+}
+
+// ---- Header / field table ----
+
+static void file_header_swap(FileHeader *h) {
+    h->endian_mark = GUINT32_SWAP_LE_BE(h->endian_mark);
+    h->version = GUINT16_SWAP_LE_BE(h->version);
+    h->header_size = GUINT16_SWAP_LE_BE(h->header_size);
+    h->record_size = GUINT32_SWAP_LE_BE(h->record_size);
+    h->field_count = GUINT32_SWAP_LE_BE(h->field_count);
+    h->block_records = GUINT32_SWAP_LE_BE(h->block_records);
+    h->record_count = GUINT32_SWAP_LE_BE(h->record_count);
+    h->seq = GUINT64_SWAP_LE_BE(h->seq);
+    h->records_offset = GUINT64_SWAP_LE_BE(h->records_offset);
+    h->crc_offset = GUINT64_SWAP_LE_BE(h->crc_offset);
+    h->header_crc = GUINT32_SWAP_LE_BE(h->header_crc);
+    h->next_id = GUINT32_SWAP_LE_BE(h->next_id);
+}
+
+static void file_field_swap(FileField *f) {
+    f->offset = GUINT32_SWAP_LE_BE(f->offset);
+    f->size = GUINT32_SWAP_LE_BE(f->size);
+    f->type = GUINT32_SWAP_LE_BE(f->type);
+    f->dict = GUINT32_SWAP_LE_BE(f->dict);
+}
+
+// CRC of the header (with header_crc zeroed) and the len bytes after it.
+static guint32 file_header_crc(const FileHeader *raw_header, const void *rest, gsize len) {
+    FileHeader h = *raw_header;
+    h.header_crc = 0;
+    guint32 crc = crc32c(0, &h, sizeof(h));
+    return crc32c(crc, rest, len);
+}
+
+// Parse the dictionary section in [p, end). Returns one array of strings
+// (pointing into the file) per dictionary, or NULL if it is malformed.
+static GPtrArray *file_parse_dictionaries(const char *p, const char *end, gboolean swapped) {
+    guint32 n;
+    if (end - p < (gssize)sizeof(n)) return NULL;
+    memcpy(&n, p, sizeof(n));
+    p += sizeof(n);
+    if (swapped) n = GUINT32_SWAP_LE_BE(n);
+    if (n > 1024) return NULL;
+
+    GPtrArray *dicts = g_ptr_array_new_with_free_func((GDestroyNotify)g_ptr_array_unref);
+    gboolean ok = TRUE;
+    for (guint32 i = 0; ok && i < n; i++) {
+        FileDictionary d;
+        ok = end - p >= (gssize)sizeof(d);
+        if (!ok) break;
+        memcpy(&d, p, sizeof(d));
+        p += sizeof(d);
+        if (swapped) {
+            d.count = GUINT32_SWAP_LE_BE(d.count);
+            d.bytes = GUINT32_SWAP_LE_BE(d.bytes);
+        }
+        // Every string takes at least its NUL, and the last one must end here
+        ok = d.bytes <= (gsize)(end - p) && d.count <= d.bytes && (d.bytes == 0 || p[d.bytes - 1] == '\0');
+        if (!ok) break;
+
+        GPtrArray *strings = g_ptr_array_sized_new(d.count);
+        g_ptr_array_add(dicts, strings);
+        const char *s = p;
+        for (guint32 k = 0; k < d.count; k++) {
+            g_ptr_array_add(strings, (gpointer)s);
+            s += strlen(s) + 1;
+        }
+        ok = s == p + d.bytes;
+        p += d.bytes;
+    }
+
+    if (!ok) {
+        g_ptr_array_unref(dicts);
+        return NULL;
+    }
+    return dicts;
+}
+
+// Inspect a snapshot. On success header and fields are filled in native
+// byte order (fields is a newly allocated copy for versioned files) and, for
+// version 2 files, dicts holds the dictionaries' strings.
+FileLayout file_parse(const char *contents, gsize length, FileHeader *header,
+                      FileField **fields, GPtrArray **dicts, gboolean *swapped) {
+    *fields = NULL;
+    *dicts = NULL;
+    *swapped = FALSE;
+
+    if (length == 0) return FILE_LAYOUT_EMPTY;
+    if (length < sizeof(header->magic) || memcmp(contents, FILE_MAGIC, sizeof(header->magic)) != 0) {
+        return FILE_LAYOUT_LEGACY;
+    }
+    // Cut short inside its own header
+    if (length < sizeof(FileHeader)) return FILE_LAYOUT_INVALID;
+
+    memcpy(header, contents, sizeof(*header));
+    if (header->endian_mark != FILE_ENDIAN_MARK) {
+        if (GUINT32_SWAP_LE_BE(header->endian_mark) != FILE_ENDIAN_MARK) return FILE_LAYOUT_INVALID;
+        file_header_swap(header);
+        *swapped = TRUE;
+    }
+
+    gsize fields_len = (gsize)header->field_count * sizeof(FileField);
+    if (header->version < 1 || header->version > FILE_FORMAT_VERSION ||
+        header->header_size != sizeof(FileHeader) ||
+        header->field_count == 0 || header->field_count > 1024 ||
+        header->block_records == 0 ||
+        sizeof(FileHeader) + fields_len > length) {
+        return FILE_LAYOUT_INVALID;
+    }
+
+    // Version 1 checksummed only the field table
+    const char *raw_fields = contents + sizeof(FileHeader);
+    gsize covered = fields_len;
+    if (header->version >= 2) {
+        if (header->records_offset < sizeof(FileHeader) + fields_len || header->records_offset > length) {
+            return FILE_LAYOUT_INVALID;
+        }
+        covered = header->records_offset - sizeof(FileHeader);
+    }
+    if (file_header_crc((const FileHeader *)contents, raw_fields, covered) != header->header_crc) {
+        return FILE_LAYOUT_INVALID;
+    }
+
+    guint64 records_len = (guint64)header->record_count * header->record_size;
+    guint64 n_blocks = ((guint64)header->record_count + header->block_records - 1) / header->block_records;
+    if (header->records_offset < sizeof(FileHeader) + fields_len ||
+        header->records_offset + records_len > header->crc_offset ||
+        header->crc_offset + n_blocks * sizeof(guint32) > length) {
+        return FILE_LAYOUT_INVALID;
+    }
+    if (header->version >= 2) {
+        *dicts = file_parse_dictionaries(raw_fields + fields_len, contents + header->records_offset, *swapped);
+        if (!*dicts) return FILE_LAYOUT_INVALID;
+    }
+
+    *fields = g_memdup2(raw_fields, fields_len);
+    gboolean native = !*swapped && header->version == FILE_FORMAT_VERSION &&
+                      header->record_size == sizeof(Student) &&
+                      header->field_count == N_STUDENT_FIELDS &&
+                      header->records_offset % G_ALIGNOF(Student) == 0;
+    for (guint32 i = 0; i < header->field_count; i++) {
+        FileField *f = &(*fields)[i];
+        if (*swapped) file_field_swap(f);
+        f->name[sizeof(f->name) - 1] = '\0';
+        if ((guint64)f->offset + f->size > header->record_size ||
+            (f->type == FIELD_CODE16 && f->size != sizeof(guint16))) {
+            g_clear_pointer(fields, g_free);
+            g_clear_pointer(dicts, g_ptr_array_unref);
+            return FILE_LAYOUT_INVALID;
+        }
+        if (native && i < N_STUDENT_FIELDS) {
+            const FileField *mine = &student_fields[i];
+            native = strcmp(f->name, mine->name) == 0 && f->offset == mine->offset &&
+                     f->size == mine->size && f->type == mine->type && f->dict == mine->dict;
+        }
+    }
+    return native ? FILE_LAYOUT_NATIVE : FILE_LAYOUT_FOREIGN;
+}
+
+// Check every block CRC. Returns the index of the first bad block, or -1.
+gint64 file_verify_blocks(const char *contents, const FileHeader *header, gboolean swapped) {
+    const char *records = contents + header->records_offset;
+    const char *crcs = contents + header->crc_offset;
+    guint64 n_blocks = ((guint64)header->record_count + header->block_records - 1) / header->block_records;
+
+    for (guint64 b = 0; b < n_blocks; b++) {
+        guint64 first = b * header->block_records;
+        guint64 n = MIN((guint64)header->block_records, header->record_count - first);
+        guint32 expected;
+        memcpy(&expected, crcs + b * sizeof(guint32), sizeof(expected));
+        if (swapped) expected = GUINT32_SWAP_LE_BE(expected);
+
+        if (crc32c(0, records + first * header->record_size, n * header->record_size) != expected) {
+            return (gint64)b;
+        }
+    }
+    return -1;
+}
+
+// Inspect the snapshot at path as it is on disk, without loading or
+// repairing it. *bad_block is the first block failing its CRC, or -1.
+FileLayout file_check(const char *path, FileHeader *header, gint64 *bad_block) {
+    *bad_block = -1;
+    GMappedFile *mapping = g_mapped_file_new(path, FALSE, NULL);
+    if (!mapping) return FILE_LAYOUT_EMPTY;
+
+    const char *contents = g_mapped_file_get_contents(mapping);
+    FileField *fields;
+    GPtrArray *dicts;
+    gboolean swapped;
+    FileLayout layout = file_parse(contents, g_mapped_file_get_length(mapping), header, &fields, &dicts, &swapped);
+    if (layout == FILE_LAYOUT_NATIVE || layout == FILE_LAYOUT_FOREIGN) {
+        *bad_block = file_verify_blocks(contents, header, swapped);
+    }
+    g_free(fields);
+    if (dicts) g_ptr_array_unref(dicts);
+    g_mapped_file_unref(mapping);
+    return layout;
+}
+
+static gboolean field_is_string(guint32 type) {
+    return type == FIELD_CHARS || type == FIELD_CODE16;
+}
+
+// The string a FIELD_CODE16 value stands for in the file's dictionaries.
+static const char *file_dict_string(GPtrArray *dicts, guint32 dict, const char *raw, gboolean swapped) {
+    guint16 code;
+    memcpy(&code, raw, sizeof(code));
+    if (swapped) code = GUINT16_SWAP_LE_BE(code);
+    if (!dicts || dict >= dicts->len) return "";
+    GPtrArray *strings = g_ptr_array_index(dicts, dict);
+    return code < strings->len ? g_ptr_array_index(strings, code) : "";
+}
+
+// Convert records written with a different layout into native Students.
+// Fields are matched by name; fields this build does not know are dropped
+// and fields the file lacks are left zeroed. String fields may change
+// between inline chars and dictionary codes; coded fields are re-interned
+// into this process's dictionaries. Returns FALSE if a dictionary ran out
+// of codes.
+gboolean file_convert_records(const char *contents, const FileHeader *header,
+                              const FileField *fields, GPtrArray *dicts, gboolean swapped,
+                              Student *out) {
+    int map[1024];
+    for (guint32 i = 0; i < header->field_count; i++) {
+        map[i] = -1;
+        for (guint32 j = 0; j < N_STUDENT_FIELDS; j++) {
+            if (strcmp(fields[i].name, student_fields[j].name) == 0 &&
+                (fields[i].type == student_fields[j].type ||
+                 (field_is_string(fields[i].type) && field_is_string(student_fields[j].type)))) {
+                map[i] = (int)j;
+                break;
+            }
+        }
+    }
+
+    gboolean ok = TRUE;
+    const char *src = contents + header->records_offset;
+    for (guint32 r = 0; r < header->record_count; r++, src += header->record_size) {
+        char *dst = (char *)&out[r];
+        memset(dst, 0, sizeof(Student));
+
+        for (guint32 i = 0; i < header->field_count; i++) {
+            if (map[i] < 0) continue;
+            const FileField *from = &fields[i];
+            const FileField *to = &student_fields[map[i]];
+
+            if (from->type == FIELD_CHARS && to->type == FIELD_CHARS) {
+                gsize n = MIN(from->size, to->size - 1);
+                memcpy(dst + to->offset, src + from->offset, n);
+                dst[to->offset + n] = '\0';
+            } else if (field_is_string(from->type)) {
+                char buf[256];
+                const char *value = buf;
+                if (from->type == FIELD_CHARS) {
+                    gsize n = strnlen(src + from->offset, MIN(from->size, sizeof(buf) - 1));
+                    memcpy(buf, src + from->offset, n);
+                    buf[n] = '\0';
+                } else {
+                    value = file_dict_string(dicts, from->dict, src + from->offset, swapped);
+                }
+
+                if (to->type == FIELD_CODE16) {
+                    guint16 code = dict_intern(to->dict, value);
+                    if (code == DICT_FULL) ok = FALSE;
+                    memcpy(dst + to->offset, &code, sizeof(code));
+                } else {
+                    g_strlcpy(dst + to->offset, value, to->size);
+                }
+            } else if (from->size == 4 && to->size == 4) {
+                guint32 v;
+                memcpy(&v, src + from->offset, 4);
+                if (swapped) v = GUINT32_SWAP_LE_BE(v);
+                memcpy(dst + to->offset, &v, 4);
+            }
+        }
+    }
+    return ok;
+}
+
+// Field table, dictionary section and padding: everything between the
+// header and the records.
+static GByteArray *file_build_tail(GPtrArray *const *dicts) {
+    GByteArray *tail = g_byte_array_new();
+    g_byte_array_append(tail, (const guint8 *)student_fields, sizeof(student_fields));
+
+    guint32 n = DICT_FIELDS;
+    g_byte_array_append(tail, (const guint8 *)&n, sizeof(n));
+    for (int f = 0; f < DICT_FIELDS; f++) {
+        GPtrArray *strings = dicts[f];
+        FileDictionary d = { strings->len, 0 };
+        for (guint i = 0; i < strings->len; i++) {
+            d.bytes += strlen(g_ptr_array_index(strings, i)) + 1;
+        }
+        g_byte_array_append(tail, (const guint8 *)&d, sizeof(d));
+        for (guint i = 0; i < strings->len; i++) {
+            const char *s = g_ptr_array_index(strings, i);
+            g_byte_array_append(tail, (const guint8 *)s, strlen(s) + 1);
+        }
+    }
+
+    static const guint8 zeros[FILE_RECORD_ALIGN] = { 0 };
+    gsize end = sizeof(FileHeader) + tail->len;
+    g_byte_array_append(tail, zeros, (FILE_RECORD_ALIGN - end % FILE_RECORD_ALIGN) % FILE_RECORD_ALIGN);
+    return tail;
+}
+
+// Write a complete snapshot in the current format. dicts holds the strings
+// of each DictField in code order.
+gboolean write_snapshot(const char *path, const Student *records, int count,
+                        guint64 seq, int next_id, GPtrArray *const *dicts) {
+    FILE *fp = fopen(path, "wb");
+    if (!fp) return FALSE;
+
+    GByteArray *tail = file_build_tail(dicts);
+    guint32 n_blocks = (guint32)(((guint64)count + FILE_BLOCK_RECORDS - 1) / FILE_BLOCK_RECORDS);
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+    header.endian_mark = FILE_ENDIAN_MARK;
+    header.version = FILE_FORMAT_VERSION;
+    header.header_size = sizeof(FileHeader);
+    header.record_size = sizeof(Student);
+    header.field_count = N_STUDENT_FIELDS;
+    header.block_records = FILE_BLOCK_RECORDS;
+    header.record_count = (guint32)count;
+    header.seq = seq;
+    header.next_id = (guint32)next_id;
+    header.records_offset = sizeof(header) + tail->len;
+    header.crc_offset = header.records_offset + (guint64)count * sizeof(Student);
+    header.header_crc = file_header_crc(&header, tail->data, tail->len);
+
+    gboolean ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+                  fwrite(tail->data, 1, tail->len, fp) == tail->len;
+    g_byte_array_unref(tail);
+
+    guint32 *crcs = g_new(guint32, MAX(n_blocks, 1));
+    for (guint32 b = 0; ok && b < n_blocks; b++) {
+        int first = (int)(b * FILE_BLOCK_RECORDS);
+        int n = MIN(FILE_BLOCK_RECORDS, count - first);
+        crcs[b] = crc32c(0, &records[first], (gsize)n * sizeof(Student));
+        ok = fwrite(&records[first], sizeof(Student), n, fp) == (size_t)n;
+    }
+    ok = ok && fwrite(crcs, sizeof(guint32), n_blocks, fp) == n_blocks;
+    g_free(crcs);
+
+    // On disk before it is renamed into place
+    ok = ok && fflush(fp) == 0 && g_fsync(fileno(fp)) == 0;
+    ok = (fclose(fp) == 0) && ok;
+    return ok;
+}
@@ -0,0 +1,445 @@
+#include "internal.h"
+#include <ctype.h>
+
+// ================== CSV IMPORT ==================
+
+// Bulk loads registrar exports: a header row naming the columns, then one
+// student per row. The file is mapped and cut into chunks at row
+// boundaries, found from the parity of the quotes before each cut, so
+// quoted fields may hold commas, newlines and "" escapes. Workers parse,
+// validate and normalise the chunks in parallel without touching the store
+// or the dictionaries. Back on the main thread, rows are deduplicated by
+// reg number, added to the store in one batch and saved with a single
+// snapshot rather than a journal entry each.
+//
+// Branch, program and gender must name one of the form's choices (case is
+// ignored), text must fit its Student buffer, and age and GPA the form's
+// ranges. Rejected rows are reported by line number.
+
+#define IMPORT_MAX_WORKERS 16
+#define IMPORT_CHUNK_MIN (1 << 20)   // Bytes per worker before another is worth it
+#define IMPORT_MAX_FIELDS 64         // Fields per row looked at
+#define IMPORT_FIELD_MAX 128         // Longest field kept, with NUL
+#define IMPORT_MAX_ERRORS 20         // Rejected rows described in the report
+
+typedef enum {
+    IMPORT_NAME,
+    IMPORT_REG,
+    IMPORT_BRANCH,
+    IMPORT_PROGRAM,
+    IMPORT_GENDER,
+    IMPORT_PHONE,
+    IMPORT_AGE,
+    IMPORT_GPA,
+    IMPORT_COLUMNS
+} ImportColumn;
+
+// Accepted header spellings, lowercase with everything but letters dropped
+static const char *const import_headers[IMPORT_COLUMNS] = {
+    "name studentname",
+    "reg regno regnum registrationno registrationnumber",
+    "branch department",
+    "program programme course",
+    "gender sex",
+    "phone phoneno phonenumber mobile",
+    "age",
+    "gpa cgpa",
+};
+
+typedef struct {
+    Student student;  // Dictionary fields left unset
+    gint8 branch, program, gender;  // Index into the form's choices, -1 for none
+    int line;
+} ImportRow;
+
+typedef struct {
+    const char *begin, *end;
+    int first_line;
+    const signed char *column_of_field;
+    guint quotes, newlines;  // First pass, over the raw cut
+    GArray *rows;            // ImportRow
+    GString *errors;
+    int rejected;
+} ImportChunk;
+
+struct ImportBatch {
+    GArray *rows;
+    int rejected;
+    GString *errors;  // "line N: reason" for the first IMPORT_MAX_ERRORS
+};
+
+static void import_reject(GString *errors, int *rejected, int line, const char *format, ...) {
+    if ((*rejected)++ >= IMPORT_MAX_ERRORS) return;
+    va_list args;
+    va_start(args, format);
+    g_string_append_printf(errors, "line %d: ", line);
+    g_string_append_vprintf(errors, format, args);
+    g_string_append_c(errors, '\n');
+    va_end(args);
+}
+
+// Read the field at *p into buf, unquoting it. *len is its full length,
+// even past what fits. Returns TRUE if another field follows on the row;
+// either way *p is left at the start of the next field or row, and *lines
+// counts the newlines passed.
+static gboolean import_next_field(const char **p, const char *end, char *buf, gsize *len, int *lines) {
+    const char *s = *p;
+    gsize n = 0;
+    gboolean quoted = s < end && *s == '"';
+    if (quoted) s++;
+
+    while (s < end) {
+        char c = *s;
+        if (quoted && c == '"') {
+            if (s + 1 < end && s[1] == '"') {
+                s++;
+            } else {
+                quoted = FALSE;
+                s++;
+                continue;
+            }
+        } else if (!quoted && (c == ',' || c == '\n' || c == '\r')) {
+            break;
+        } else if (c == '\n') {
+            (*lines)++;
+        }
+        if (n < IMPORT_FIELD_MAX - 1) buf[n] = *s;
+        n++;
+        s++;
+    }
+    buf[MIN(n, IMPORT_FIELD_MAX - 1)] = '\0';
+    *len = n;
+
+    gboolean more = s < end && *s == ',';
+    if (more) {
+        s++;
+    } else {
+        if (s < end && *s == '\r') s++;
+        if (s < end && *s == '\n') {
+            s++;
+            (*lines)++;
+        }
+    }
+    *p = s;
+    return more;
+}
+
+static int import_choice(const char *const *choices, const char *value) {
+    for (int i = 0; choices[i]; i++) {
+        if (g_ascii_strcasecmp(choices[i], value) == 0) return i;
+    }
+    return -1;
+}
+
+// Fill row from one row's fields, or say why it is rejected.
+static const char *import_row_from_fields(char fields[IMPORT_COLUMNS][IMPORT_FIELD_MAX],
+                                          const gsize *lengths, ImportRow *row) {
+    Student *s = &row->student;
+    for (int c = 0; c < IMPORT_COLUMNS; c++) {
+        if (lengths[c] >= IMPORT_FIELD_MAX || !g_utf8_validate(fields[c], -1, NULL)) {
+            return "a field is too long or not UTF-8";
+        }
+        g_strstrip(fields[c]);
+    }
+
+    // Runs of spaces in names collapse to one
+    char *name = fields[IMPORT_NAME];
+    gsize n = 0;
+    for (gsize i = 0; name[i]; i++) {
+        if (g_ascii_isspace(name[i]) && n > 0 && name[n - 1] == ' ') continue;
+        name[n++] = g_ascii_isspace(name[i]) ? ' ' : name[i];
+    }
+    name[n] = '\0';
+    if (!*name) return "name is empty";
+    if (n >= sizeof(s->name)) return "name is too long";
+    strcpy(s->name, name);
+
+    char *reg = fields[IMPORT_REG];
+    if (!*reg) return "reg number is empty";
+    if (strlen(reg) >= sizeof(s->reg_num)) return "reg number is too long";
+    for (char *c = reg; *c; c++) {
+        if (g_ascii_isspace(*c)) return "reg number contains spaces";
+        *c = g_ascii_toupper(*c);
+    }
+    strcpy(s->reg_num, reg);
+
+    int branch = import_choice(branch_choices, fields[IMPORT_BRANCH]);
+    int program = import_choice(program_choices, fields[IMPORT_PROGRAM]);
+    int gender = *fields[IMPORT_GENDER] ? import_choice(gender_choices, fields[IMPORT_GENDER]) : G_MAXINT;
+    if (branch < 0) return "unknown branch";
+    if (program < 0) return "unknown program";
+    if (gender < 0) return "unknown gender";
+    row->branch = branch;
+    row->program = program;
+    row->gender = gender == G_MAXINT ? -1 : gender;
+
+    const char *phone = fields[IMPORT_PHONE];
+    if (strlen(phone) >= sizeof(s->phone)) return "phone number is too long";
+    for (const char *c = phone; *c; c++) {
+        if (!g_ascii_isdigit(*c) && !strchr("+-() ", *c)) return "phone number has letters";
+    }
+    strcpy(s->phone, phone);
+
+    char *end;
+    if (*fields[IMPORT_AGE]) {
+        gint64 age = g_ascii_strtoll(fields[IMPORT_AGE], &end, 10);
+        if (*end || age < 16 || age > 60) return "age is not a number from 16 to 60";
+        s->age = (int)age;
+    }
+    if (*fields[IMPORT_GPA]) {
+        double gpa = g_ascii_strtod(fields[IMPORT_GPA], &end);
+        if (*end || !(gpa >= 0.0 && gpa <= 10.0)) return "GPA is not a number from 0 to 10";
+        // The form's step
+        s->gpa = (float)(round(gpa * 100.0) / 100.0);
+    }
+    return NULL;
+}
+
+static gpointer import_count_worker(gpointer data) {
+    ImportChunk *chunk = data;
+    for (const char *p = chunk->begin; p < chunk->end; p++) {
+        chunk->quotes += *p == '"';
+        chunk->newlines += *p == '\n';
+    }
+    return NULL;
+}
+
+static gpointer import_parse_worker(gpointer data) {
+    ImportChunk *chunk = data;
+    char fields[IMPORT_COLUMNS][IMPORT_FIELD_MAX];
+    gsize lengths[IMPORT_COLUMNS];
+    char scratch[IMPORT_FIELD_MAX];
+    const char *p = chunk->begin;
+    int line = chunk->first_line;
+
+    while (p < chunk->end) {
+        ImportRow row;
+        memset(&row, 0, sizeof(row));
+        row.line = line;
+        memset(lengths, 0, sizeof(lengths));
+        for (int c = 0; c < IMPORT_COLUMNS; c++) fields[c][0] = '\0';
+
+        gboolean blank = TRUE;
+        gboolean more = TRUE;
+        for (int f = 0; more; f++) {
+            int column = f < IMPORT_MAX_FIELDS ? chunk->column_of_field[f] : -1;
+            gsize len;
+            more = import_next_field(&p, chunk->end, column >= 0 ? fields[column] : scratch, &len, &line);
+            if (column >= 0) lengths[column] = len;
+            blank = blank && len == 0;
+        }
+        if (blank) continue;
+
+        const char *reason = import_row_from_fields(fields, lengths, &row);
+        if (reason) import_reject(chunk->errors, &chunk->rejected, row.line, "%s", reason);
+        else g_array_append_val(chunk->rows, row);
+    }
+    return NULL;
+}
+
+static void import_parallel(GThreadFunc func, ImportChunk *chunks, int workers) {
+    GThread *threads[IMPORT_MAX_WORKERS];
+    for (int w = 0; w < workers; w++) {
+        threads[w] = workers > 1 ? g_thread_new("import", func, &chunks[w]) : NULL;
+        if (!threads[w]) func(&chunks[w]);
+    }
+    for (int w = 0; w < workers; w++) {
+        if (threads[w]) g_thread_join(threads[w]);
+    }
+}
+
+void import_batch_free(ImportBatch *batch) {
+    g_array_unref(batch->rows);
+    g_string_free(batch->errors, TRUE);
+    g_free(batch);
+}
+
+// Parse and validate a CSV file. Safe to call off the main thread. Returns
+// NULL and sets *error if the file cannot be read or lacks a required
+// column.
+ImportBatch *import_parse(const char *path, char **error) {
+    GError *map_error = NULL;
+    GMappedFile *mapping = g_mapped_file_new(path, FALSE, &map_error);
+    if (!mapping) {
+        *error = g_strdup(map_error->message);
+        g_error_free(map_error);
+        return NULL;
+    }
+    const char *p = g_mapped_file_get_contents(mapping);
+    const char *end = p + g_mapped_file_get_length(mapping);
+    if (end - p >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0) p += 3;
+
+    // Header row
+    signed char column_of_field[IMPORT_MAX_FIELDS];
+    memset(column_of_field, -1, sizeof(column_of_field));
+    gboolean present[IMPORT_COLUMNS] = { FALSE };
+    int line = 1;
+    char field[IMPORT_FIELD_MAX];
+    gboolean more = TRUE;
+    for (int f = 0; more && p < end; f++) {
+        gsize len;
+        more = import_next_field(&p, end, field, &len, &line);
+        char key[IMPORT_FIELD_MAX];
+        gsize k = 0;
+        for (const char *c = field; *c; c++) {
+            if (g_ascii_isalpha(*c)) key[k++] = g_ascii_tolower(*c);
+        }
+        key[k] = '\0';
+        for (int c = 0; k > 0 && f < IMPORT_MAX_FIELDS && c < IMPORT_COLUMNS; c++) {
+            char **names = g_strsplit(import_headers[c], " ", -1);
+            if (!present[c] && g_strv_contains((const char *const *)names, key)) {
+                column_of_field[f] = c;
+                present[c] = TRUE;
+            }
+            g_strfreev(names);
+        }
+    }
+    for (int c = IMPORT_NAME; c <= IMPORT_PROGRAM; c++) {
+        if (!present[c]) {
+            const char *headers[] = {"name", "reg number", "branch", "program"};
+            *error = g_strdup_printf("No %s column in the header row", headers[c]);
+            g_mapped_file_unref(mapping);
+            return NULL;
+        }
+    }
+
+    // Cut the rows into roughly even chunks
+    gsize length = end - p;
+    int workers = CLAMP((int)(length / IMPORT_CHUNK_MIN), 1,
+                        MIN((int)g_get_num_processors(), IMPORT_MAX_WORKERS));
+    ImportChunk chunks[IMPORT_MAX_WORKERS];
+    memset(chunks, 0, sizeof(chunks));
+    for (int w = 0; w < workers; w++) {
+        chunks[w].begin = p + length * w / workers;
+        chunks[w].end = p + length * (w + 1) / workers;
+    }
+    import_parallel(import_count_worker, chunks, workers);
+
+    // Move each cut forward to the next row start outside quotes
+    guint quotes = 0;
+    int lines = line;  // At the uncut start of chunk w
+    for (int w = 0; w < workers; w++) {
+        const char *s = chunks[w].begin;
+        if (w > 0) {
+            gboolean quoted = quotes % 2;
+            while (s < chunks[w].end && (quoted || s[-1] != '\n')) {
+                if (*s == '"') quoted = !quoted;
+                s++;
+            }
+            chunks[w - 1].end = s;
+        }
+        chunks[w].first_line = lines;
+        for (const char *c = chunks[w].begin; c < s; c++) chunks[w].first_line += *c == '\n';
+        chunks[w].begin = s;
+        lines += chunks[w].newlines;
+        quotes += chunks[w].quotes;
+        chunks[w].column_of_field = column_of_field;
+        chunks[w].rows = g_array_new(FALSE, FALSE, sizeof(ImportRow));
+        chunks[w].errors = g_string_new(NULL);
+    }
+    import_parallel(import_parse_worker, chunks, workers);
+
+    ImportBatch *batch = g_new0(ImportBatch, 1);
+    batch->rows = chunks[0].rows;
+    batch->errors = g_string_new(NULL);
+    for (int w = 0; w < workers; w++) {
+        if (w > 0) {
+            g_array_append_vals(batch->rows, chunks[w].rows->data, chunks[w].rows->len);
+            g_array_unref(chunks[w].rows);
+        }
+        // Keep the report to the first rejected rows of the file
+        int room = MAX(IMPORT_MAX_ERRORS - MIN(batch->rejected, IMPORT_MAX_ERRORS), 0);
+        const char *e = chunks[w].errors->str;
+        for (int i = 0; i < room && *e; i++) {
+            const char *nl = strchr(e, '\n');
+            g_string_append_len(batch->errors, e, nl - e + 1);
+            e = nl + 1;
+        }
+        batch->rejected += chunks[w].rejected;
+        g_string_free(chunks[w].errors, TRUE);
+    }
+    g_mapped_file_unref(mapping);
+    return batch;
+}
+
+// Add a parsed batch to the store and journal it. Rows whose reg number is
+// already taken, in the store or earlier in the file, are rejected. Main
+// thread only. Returns how many students were added.
+int import_commit(ImportBatch *batch) {
+    guint16 branch_codes[G_N_ELEMENTS(branch_choices)];
+    guint16 program_codes[G_N_ELEMENTS(program_choices)];
+    guint16 gender_codes[G_N_ELEMENTS(gender_choices)];
+    guint16 subject_codes[6];
+    for (int i = 0; branch_choices[i]; i++) branch_codes[i] = dict_intern(DICT_BRANCH, branch_choices[i]);
+    for (int i = 0; program_choices[i]; i++) program_codes[i] = dict_intern(DICT_PROGRAM, program_choices[i]);
+    for (int i = 0; gender_choices[i]; i++) gender_codes[i] = dict_intern(DICT_GENDER, gender_choices[i]);
+    for (int j = 0; j < 6; j++) subject_codes[j] = dict_intern(DICT_SUBJECT, default_subject_names[j]);
+
+    // Reg numbers were uppercased while parsing
+    GHashTable *seen = g_hash_table_new(g_str_hash, g_str_equal);
+    Student *students = g_new(Student, MAX(batch->rows->len, 1));
+    int n = 0;
+    for (guint i = 0; i < batch->rows->len; i++) {
+        ImportRow *row = &g_array_index(batch->rows, ImportRow, i);
+        Student *s = &row->student;
+        gpointer first = g_hash_table_lookup(seen, s->reg_num);
+        if (first) {
+            import_reject(batch->errors, &batch->rejected, row->line,
+                          "reg number %s repeats line %d", s->reg_num, GPOINTER_TO_INT(first));
+            continue;
+        }
+        g_hash_table_insert(seen, s->reg_num, GINT_TO_POINTER(row->line));
+        if (store_find_reg(s->reg_num) >= 0) {
+            import_reject(batch->errors, &batch->rejected, row->line,
+                          "reg number %s is already in the records", s->reg_num);
+            continue;
+        }
+
+        students[n] = *s;
+        students[n].id = 0;
+        students[n].branch = branch_codes[row->branch];
+        students[n].program = program_codes[row->program];
+        students[n].gender = row->gender < 0 ? 0 : gender_codes[row->gender];
+        for (int j = 0; j < 6; j++) students[n].subjects[j].subject_name = subject_codes[j];
+        if (!student_codes_valid(&students[n])) {
+            import_reject(batch->errors, &batch->rejected, row->line, "too many distinct names to store");
+            continue;
+        }
+        n++;
+    }
+    g_hash_table_destroy(seen);
+
+    // Inserts go on the end, so the added records are the last slots
+    int first = store.count;
+    int added = store_insert_batch(&store, students, n);
+    g_free(students);
+    journal_append_inserts(&store.records[first], store.count - first);
+    return added;
+}
+
+char *import_summary(const ImportBatch *batch, int added) {
+    GString *text = g_string_new(NULL);
+    g_string_append_printf(text, "Imported %d students, rejected %d rows.\n", added, batch->rejected);
+    g_string_append(text, batch->errors->str);
+    if (batch->rejected > IMPORT_MAX_ERRORS) {
+        g_string_append_printf(text, "…and %d more\n", batch->rejected - IMPORT_MAX_ERRORS);
+    }
+    return g_string_free(text, FALSE);
+}
+
+// Headless import for the command line. Returns the exit status.
+int import_file(const char *path) {
+    char *error = NULL;
+    ImportBatch *batch = import_parse(path, &error);
+    if (!batch) {
+        g_printerr("Error: %s: %s\n", path, error);
+        g_free(error);
+        return 1;
+    }
+    int added = import_commit(batch);
+    char *summary = import_summary(batch, added);
+    g_print("%s", summary);
+    g_free(summary);
+    import_batch_free(batch);
+    return 0;
+}
@@ -0,0 +1,437 @@
+#include "internal.h"
+#include <ctype.h>
+
+// ================== SEARCH INDEX ==================
+
+// Backs plain text in the search box (see QUERY). Reg numbers are kept in
+// a case-insensitive sorted order for exact and prefix lookups; names are
+// broken into lowercase trigrams, each mapping to the list of students
+// containing it. A name query intersects nothing: it walks the shortest
+// posting list among its trigrams and confirms each candidate with a
+// substring check.
+//
+// Entries are record ids, so compaction moving records leaves the index
+// alone. Inserts extend it in place. A delete drops its reg_order entry, an
+// edit that changes the name or reg number re-adds the record, and bulk
+// inserts mark the index stale so it is rebuilt on the next search.
+// Posting lists keep ids of deleted students and old trigrams of renamed
+// ones; the substring check that confirms each candidate weeds them out.
+
+typedef struct {
+    int *reg_order;        // Ids sorted by reg_num
+    int reg_count;
+    GHashTable *trigrams;  // Packed trigram -> GArray of int ids
+    gboolean built;
+    gboolean stale;
+} SearchIndex;
+
+SearchIndex search_index = { NULL, 0, NULL, FALSE, FALSE };
+
+#define TRIGRAM(a, b, c) \
+    (((guint32)(guchar)(a) << 16) | ((guint32)(guchar)(b) << 8) | (guint32)(guchar)(c))
+
+static void posting_list_free(gpointer data) {
+    g_array_free(data, TRUE);
+}
+
+static void trigram_index_add(GHashTable *trigrams, const char *name, int id) {
+    char lower[sizeof(((Student *)0)->name)];
+    gsize len = 0;
+    for (; name[len] && len < sizeof(lower) - 1; len++) {
+        lower[len] = g_ascii_tolower(name[len]);
+    }
+
+    for (gsize i = 0; i + 3 <= len; i++) {
+        gpointer key = GUINT_TO_POINTER(TRIGRAM(lower[i], lower[i + 1], lower[i + 2]));
+        GArray *postings = g_hash_table_lookup(trigrams, key);
+        if (!postings) {
+            postings = g_array_new(FALSE, FALSE, sizeof(int));
+            g_hash_table_insert(trigrams, key, postings);
+        }
+        // A name repeating a trigram must not list the id twice
+        if (postings->len == 0 || g_array_index(postings, int, postings->len - 1) != id) {
+            g_array_append_val(postings, id);
+        }
+    }
+}
+
+// Reg number of a live student in the index.
+static const char *search_reg_of(int id) {
+    return store.records[store.slot_of_id[id]].reg_num;
+}
+
+static int reg_order_compare(gconstpointer a, gconstpointer b, gpointer user_data) {
+    return g_ascii_strcasecmp(search_reg_of(*(const int *)a), search_reg_of(*(const int *)b));
+}
+
+// First position in reg_order whose reg_num is not less than key, comparing
+// at most len characters (so a prefix compares equal to its extensions).
+static int reg_order_lower_bound(const char *key, gsize len) {
+    int lo = 0, hi = search_index.reg_count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (g_ascii_strncasecmp(search_reg_of(search_index.reg_order[mid]), key, len) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Rebuild from the store. A search worker passes its cancellable and gives
+// up part way (leaving the index unbuilt) when a store change cancels it.
+static gboolean search_index_build(GCancellable *cancellable) {
+    g_free(search_index.reg_order);
+    if (search_index.trigrams) g_hash_table_destroy(search_index.trigrams);
+
+    int slots = store_slots(&store);
+    int count = 0;
+    search_index.reg_order = g_new(int, MAX(store_count(&store), 1));
+    search_index.trigrams = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, posting_list_free);
+
+    search_index.built = FALSE;
+    for (int i = 0; i < slots; i++) {
+        if (i % 65536 == 0 && g_cancellable_is_cancelled(cancellable)) return FALSE;
+        if (!store_is_live(&store, i)) continue;
+        search_index.reg_order[count++] = store.records[i].id;
+        trigram_index_add(search_index.trigrams, store.records[i].name, store.records[i].id);
+    }
+    search_index.reg_count = count;
+    g_qsort_with_data(search_index.reg_order, count, sizeof(int), reg_order_compare, NULL);
+
+    search_index.built = TRUE;
+    search_index.stale = FALSE;
+    return TRUE;
+}
+
+void search_index_rebuild() {
+    search_index_build(NULL);
+}
+
+// Called by the store once the record in slot is live and mapped to its id.
+void search_index_on_insert(int slot) {
+    if (!search_index.built || search_index.stale) return;
+
+    const Student *student = &store.records[slot];
+    int pos = reg_order_lower_bound(student->reg_num, sizeof(student->reg_num));
+    search_index.reg_order = g_renew(int, search_index.reg_order, search_index.reg_count + 1);
+    memmove(&search_index.reg_order[pos + 1], &search_index.reg_order[pos],
+            (gsize)(search_index.reg_count - pos) * sizeof(int));
+    search_index.reg_order[pos] = student->id;
+    search_index.reg_count++;
+
+    trigram_index_add(search_index.trigrams, student->name, student->id);
+}
+
+// Called by the store before the record in slot is deleted or replaced.
+void search_index_on_remove(int slot) {
+    if (!search_index.built || search_index.stale) return;
+
+    const Student *student = &store.records[slot];
+    gsize len = sizeof(student->reg_num);
+    for (int pos = reg_order_lower_bound(student->reg_num, len); pos < search_index.reg_count; pos++) {
+        int id = search_index.reg_order[pos];
+        if (g_ascii_strncasecmp(search_reg_of(id), student->reg_num, len) != 0) break;
+        if (id != student->id) continue;
+        memmove(&search_index.reg_order[pos], &search_index.reg_order[pos + 1],
+                (gsize)(search_index.reg_count - pos - 1) * sizeof(int));
+        search_index.reg_count--;
+        return;
+    }
+}
+
+void search_index_invalidate() {
+    search_index.stale = TRUE;
+}
+
+gboolean ascii_contains_lower(const char *haystack, const char *needle_lower, gsize needle_len) {
+    for (; *haystack; haystack++) {
+        gsize i = 0;
+        while (i < needle_len && haystack[i] && g_ascii_tolower(haystack[i]) == needle_lower[i]) i++;
+        if (i == needle_len) return TRUE;
+    }
+    return FALSE;
+}
+
+// Whether student's reg_num starts with needle or its name contains it,
+// needle being lowercased and trimmed.
+gboolean search_text_matches(const Student *student, const char *needle, gsize len) {
+    return len > 0 &&
+        (g_ascii_strncasecmp(student->reg_num, needle, len) == 0 ||
+         ascii_contains_lower(student->name, needle, len));
+}
+
+// Set the bit in hits of every slot search_text_matches would accept.
+void search_text_hits(const char *needle, gsize len, guint64 *hits, GCancellable *cancellable) {
+    int count = store_slots(&store);
+    if (len == 0 || count == 0) return;
+    if ((!search_index.built || search_index.stale) && !search_index_build(cancellable)) return;
+
+#define MARK_HIT(slot) (hits[(slot) / 64] |= G_GUINT64_CONSTANT(1) << ((slot) % 64))
+
+    // Reg number prefix range
+    for (int pos = reg_order_lower_bound(needle, len); pos < search_index.reg_count; pos++) {
+        int slot = store.slot_of_id[search_index.reg_order[pos]];
+        if (g_ascii_strncasecmp(store.records[slot].reg_num, needle, len) != 0) break;
+        MARK_HIT(slot);
+    }
+
+    // Name substring: narrow by the rarest trigram, then confirm
+    if (len >= 3) {
+        GArray *shortest = NULL;
+        for (gsize i = 0; i + 3 <= len; i++) {
+            GArray *postings = g_hash_table_lookup(search_index.trigrams,
+                GUINT_TO_POINTER(TRIGRAM(needle[i], needle[i + 1], needle[i + 2])));
+            if (!postings) {
+                shortest = NULL;
+                break;
+            }
+            if (!shortest || postings->len < shortest->len) shortest = postings;
+        }
+        for (guint i = 0; shortest && i < shortest->len; i++) {
+            int slot = store_slot_of(&store, g_array_index(shortest, int, i));
+            if (slot >= 0 && ascii_contains_lower(store.records[slot].name, needle, len)) MARK_HIT(slot);
+        }
+    } else {
+        // Too short for a trigram, scan the names directly
+        for (int slot = 0; slot < count; slot++) {
+            if (store_is_live(&store, slot) &&
+                ascii_contains_lower(store.records[slot].name, needle, len)) MARK_HIT(slot);
+        }
+    }
+#undef MARK_HIT
+}
+
+// Set the bit in hits of every slot whose reg_num equals reg, ignoring case.
+void search_reg_hits(const char *reg, guint64 *hits, GCancellable *cancellable) {
+    gsize len = strlen(reg);
+    if (len == 0 || store_slots(&store) == 0) return;
+    if ((!search_index.built || search_index.stale) && !search_index_build(cancellable)) return;
+
+    for (int pos = reg_order_lower_bound(reg, len); pos < search_index.reg_count; pos++) {
+        int slot = store.slot_of_id[search_index.reg_order[pos]];
+        if (g_ascii_strncasecmp(store.records[slot].reg_num, reg, len) != 0) break;
+        if (store.records[slot].reg_num[len] == '\0') hits[slot / 64] |= G_GUINT64_CONSTANT(1) << (slot % 64);
+    }
+}
+
+// ================== REG NUMBER INDEX ==================
+
+// Open-addressing hash from reg_num (case-insensitive) to record id, used
+// to reject duplicate reg numbers and look students up in O(1). The table
+// is split into REG_INDEX_SHARDS independent linear-probing shards chosen
+// by the top hash bits, so a rebuild can hash records on every core and
+// then fill each shard from its own thread without any locking. Buckets
+// cache the full hash, so probes and growth rarely touch the records.
+
+typedef struct {
+    gint32 *ids;       // Record id per bucket, -1 when empty
+    guint32 *hashes;
+    guint32 mask;
+    guint32 used;
+} RegShard;
+
+typedef struct {
+    RegShard shards[REG_INDEX_SHARDS];
+    gboolean built;
+} RegIndex;
+
+RegIndex reg_index;
+
+static guint32 reg_hash(const char *reg) {
+    // FNV-1a over upper-cased bytes, then a finalizer so the top bits
+    // used for shard selection are well mixed
+    guint32 h = 2166136261u;
+    for (gsize i = 0; i < sizeof(((Student *)0)->reg_num) && reg[i]; i++) {
+        h ^= (guchar)g_ascii_toupper(reg[i]);
+        h *= 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    return h;
+}
+
+#define REG_SHARD_OF(hash) ((hash) >> (32 - REG_INDEX_SHARD_BITS))
+
+static void reg_shard_init(RegShard *shard, guint32 capacity) {
+    g_free(shard->ids);
+    g_free(shard->hashes);
+    shard->ids = g_new(gint32, capacity);
+    shard->hashes = g_new(guint32, capacity);
+    memset(shard->ids, 0xFF, capacity * sizeof(gint32));
+    shard->mask = capacity - 1;
+    shard->used = 0;
+}
+
+static gint32 reg_shard_find(const RegShard *shard, guint32 hash, const char *reg) {
+    if (!shard->ids) return -1;
+    for (guint32 b = hash & shard->mask;; b = (b + 1) & shard->mask) {
+        gint32 id = shard->ids[b];
+        if (id < 0) return -1;
+        if (shard->hashes[b] == hash &&
+            g_ascii_strncasecmp(store_lookup(&store, id)->reg_num, reg, sizeof(((Student *)0)->reg_num)) == 0) {
+            return id;
+        }
+    }
+}
+
+static void reg_shard_place(RegShard *shard, guint32 hash, gint32 id) {
+    guint32 b = hash & shard->mask;
+    while (shard->ids[b] >= 0) b = (b + 1) & shard->mask;
+    shard->ids[b] = id;
+    shard->hashes[b] = hash;
+    shard->used++;
+}
+
+// Keep the load factor at or below one half.
+static void reg_shard_grow(RegShard *shard) {
+    if (shard->ids && (shard->used + 1) * 2 <= shard->mask + 1) return;
+
+    RegShard old = *shard;
+    guint32 capacity = shard->ids ? (shard->mask + 1) * 2 : 64;
+    shard->ids = NULL;
+    shard->hashes = NULL;
+    reg_shard_init(shard, capacity);
+
+    for (guint32 b = 0; old.ids && b <= old.mask; b++) {
+        if (old.ids[b] >= 0) reg_shard_place(shard, old.hashes[b], old.ids[b]);
+    }
+    g_free(old.ids);
+    g_free(old.hashes);
+}
+
+// Returns FALSE if reg is already present.
+static gboolean reg_shard_insert(RegShard *shard, guint32 hash, const char *reg, gint32 id) {
+    if (reg_shard_find(shard, hash, reg) >= 0) return FALSE;
+    reg_shard_grow(shard);
+    reg_shard_place(shard, hash, id);
+    return TRUE;
+}
+
+// Backward-shift deletion keeps probe chains intact without tombstones.
+static void reg_shard_remove(RegShard *shard, guint32 hash, gint32 id) {
+    if (!shard->ids) return;
+
+    guint32 b = hash & shard->mask;
+    while (shard->ids[b] != id) {
+        if (shard->ids[b] < 0) return;
+        b = (b + 1) & shard->mask;
+    }
+
+    for (guint32 next = (b + 1) & shard->mask;; next = (next + 1) & shard->mask) {
+        if (shard->ids[next] < 0) break;
+        guint32 home = shard->hashes[next] & shard->mask;
+        // Move next back into the hole unless its home lies in (b, next]
+        if (((next - home) & shard->mask) >= ((next - b) & shard->mask)) {
+            shard->ids[b] = shard->ids[next];
+            shard->hashes[b] = shard->hashes[next];
+            b = next;
+        }
+    }
+    shard->ids[b] = -1;
+    shard->used--;
+}
+
+// Id of the student with this reg number, or -1.
+int store_find_reg(const char *reg) {
+    guint32 hash = reg_hash(reg);
+    return reg_shard_find(&reg_index.shards[REG_SHARD_OF(hash)], hash, reg);
+}
+
+gboolean reg_index_on_insert(int slot) {
+    if (!reg_index.built) return TRUE;
+    const Student *student = &store.records[slot];
+    guint32 hash = reg_hash(student->reg_num);
+    return reg_shard_insert(&reg_index.shards[REG_SHARD_OF(hash)], hash, student->reg_num, student->id);
+}
+
+void reg_index_on_remove(int slot) {
+    if (!reg_index.built) return;
+    const Student *student = &store.records[slot];
+    guint32 hash = reg_hash(student->reg_num);
+    reg_shard_remove(&reg_index.shards[REG_SHARD_OF(hash)], hash, student->id);
+}
+
+typedef struct {
+    guint32 *hashes;
+    int begin, end;       // Record range to hash
+    int worker, workers;  // Shards with shard % workers == worker
+    int duplicates;
+} RegBuildTask;
+
+static gpointer reg_hash_worker(gpointer data) {
+    RegBuildTask *task = data;
+    for (int i = task->begin; i < task->end; i++) {
+        task->hashes[i] = reg_hash(store.records[i].reg_num);
+    }
+    return NULL;
+}
+
+static gpointer reg_fill_worker(gpointer data) {
+    RegBuildTask *task = data;
+    int count = store_slots(&store);
+    for (int i = 0; i < count; i++) {
+        if (!store_is_live(&store, i)) continue;
+        guint32 hash = task->hashes[i];
+        guint32 s = REG_SHARD_OF(hash);
+        if ((int)(s % task->workers) != task->worker) continue;
+        if (!reg_shard_insert(&reg_index.shards[s], hash, store.records[i].reg_num, store.records[i].id)) {
+            task->duplicates++;
+        }
+    }
+    return NULL;
+}
+
+// Rebuild from scratch using every core: one pass hashes record ranges in
+// parallel, a second lets each worker fill the shards it owns. Scanning in
+// slot order means the first of any duplicate reg numbers wins.
+// Forget every record, as store_clear does; lookups find nothing and inserts
+// skip the index until the next reg_index_rebuild.
+void reg_index_reset() {
+    for (int s = 0; s < REG_INDEX_SHARDS; s++) {
+        g_free(reg_index.shards[s].ids);
+        g_free(reg_index.shards[s].hashes);
+        reg_index.shards[s] = (RegShard){ NULL, NULL, 0, 0 };
+    }
+    reg_index.built = FALSE;
+}
+
+void reg_index_rebuild() {
+    int count = store_slots(&store);
+    int workers = CLAMP((int)g_get_num_processors(), 1, REG_INDEX_SHARDS);
+    if (count < 4096) workers = 1;
+
+    for (int s = 0; s < REG_INDEX_SHARDS; s++) {
+        guint32 capacity = 64;
+        while (capacity < (guint32)(count / REG_INDEX_SHARDS) * 2 + 2) capacity *= 2;
+        reg_shard_init(&reg_index.shards[s], capacity);
+    }
+
+    guint32 *hashes = g_new(guint32, MAX(count, 1));
+    RegBuildTask tasks[REG_INDEX_SHARDS];
+    GThread *threads[REG_INDEX_SHARDS];
+
+    for (int phase = 0; phase < 2; phase++) {
+        for (int w = 0; w < workers; w++) {
+            tasks[w] = (RegBuildTask){ hashes, (int)((gint64)count * w / workers),
+                                       (int)((gint64)count * (w + 1) / workers), w, workers, 0 };
+            GThreadFunc func = phase == 0 ? reg_hash_worker : reg_fill_worker;
+            threads[w] = workers > 1 ? g_thread_new("reg-index", func, &tasks[w]) : NULL;
+            if (!threads[w]) func(&tasks[w]);
+        }
+        for (int w = 0; w < workers; w++) {
+            if (threads[w]) g_thread_join(threads[w]);
+        }
+    }
+
+    int duplicates = 0;
+    for (int w = 0; w < workers; w++) duplicates += tasks[w].duplicates;
+    if (duplicates > 0) {
+        g_printerr("Warning: %d students share a reg number with an earlier record\n", duplicates);
+    }
+
+    g_free(hashes);
+    reg_index.built = TRUE;
+}
@@ -0,0 +1,119 @@
+// Shared between the engine's own modules; front ends use students.h.
+
+#ifndef STUDENTS_INTERNAL_H
+#define STUDENTS_INTERNAL_H
+
+#include "students.h"
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define STORE_INITIAL_CAPACITY 64
+#define STORE_RANK_WORDS 8           // Bitset words per rank directory entry
+#define STORE_COMPACT_MIN_DEAD 64
+#define STORE_COMPACT_CHUNK 65536    // Slots examined per idle compaction step
+#define JOURNAL_COMPACT_THRESHOLD 4096
+#define PERSIST_SNAPSHOT_RETRIES 3     // Failed snapshots retried at once, then on the next change
+#define JOURNAL_MAGIC 0x344E524Au        // "JRN4", ids, dictionary-coded records
+#define JOURNAL_MAGIC_V3 0x334E524Au     // "JRN3", ids, StudentV1 records
+#define JOURNAL_MAGIC_V2 0x324E524Au     // "JRN2", positions with a CRC
+#define JOURNAL_MAGIC_V1 0x4C4E524Au     // "JRNL", positions, no CRC
+#define LEGACY_TRAILER_MAGIC 0x31514553u // "SEQ1"
+#define FILE_MAGIC "SRMSDAT"
+#define FILE_FORMAT_VERSION 2
+#define FILE_ENDIAN_MARK 0x01020304u
+#define FILE_BLOCK_RECORDS 1024
+#define FILE_RECORD_ALIGN 64
+#define DICT_MAX_LENGTH 64              // Longest dictionary string, with NUL
+#define REG_INDEX_SHARD_BITS 4
+#define REG_INDEX_SHARDS (1 << REG_INDEX_SHARD_BITS)
+
+// Record layout before dictionary coding: legacy raw dumps and journals
+// older than JRN4 hold these.
+typedef struct {
+    int id;
+    char name[50];
+    char reg_num[20];
+    char branch[30];
+    char program[20];
+    char gender[10];
+    char phone[15];
+    int age;
+    float gpa;
+    struct {
+        char subject_name[50];
+        float marks;
+    } subjects[6];
+} StudentV1;
+
+gboolean student_from_v1(const StudentV1 *in, Student *out);
+
+// ---- Store internals (RECORD STORE) ----
+
+guint64 store_live_word(const StudentStore *s, int word);
+
+// Secondary indexes and aggregates kept in step with the store (see SEARCH
+// INDEX, REG NUMBER INDEX, COLUMNS, SORTING and STATISTICS)
+void columns_on_store(int slot);
+void columns_on_move(int from, int to);
+void stats_on_insert(int slot);
+void stats_on_remove(int slot);
+void sort_on_insert(int slot);
+void sort_on_remove(int slot);
+void sort_drop_orders();
+void sort_restore_active();
+void search_index_on_insert(int slot);
+void search_index_on_remove(int slot);
+void search_index_invalidate();
+gboolean reg_index_on_insert(int slot);
+void reg_index_on_remove(int slot);
+void reg_index_reset();
+
+// Struct-of-arrays shadow of the numeric and categorical fields (see COLUMNS)
+typedef struct {
+    int capacity;
+    int *age;
+    float *gpa;
+    float *marks[6];
+    guint16 *code[DICT_GROUP_FIELDS];
+    gboolean built;
+} StudentColumns;
+
+extern StudentColumns columns;
+
+guint16 student_dict_code(const Student *student, DictField field);
+
+// ---- Search index ----
+
+gboolean ascii_contains_lower(const char *haystack, const char *needle_lower, gsize needle_len);
+gboolean search_text_matches(const Student *student, const char *needle, gsize len);
+void search_text_hits(const char *needle, gsize len, guint64 *hits, GCancellable *cancellable);
+void search_reg_hits(const char *reg, guint64 *hits, GCancellable *cancellable);
+
+// ---- On-disk format ----
+
+typedef struct {
+    char name[32];
+    guint32 offset;
+    guint32 size;
+    guint32 type;
+    guint32 dict;       // DictField a FIELD_CODE16 field indexes
+} FileField;
+
+typedef struct {
+    guint32 magic;
+    guint32 reserved;
+    guint64 seq;
+} LegacyTrailer;
+
+FileLayout file_parse(const char *contents, gsize length, FileHeader *header,
+                      FileField **fields, GPtrArray **dicts, gboolean *swapped);
+gint64 file_verify_blocks(const char *contents, const FileHeader *header, gboolean swapped);
+gboolean file_convert_records(const char *contents, const FileHeader *header,
+                              const FileField *fields, GPtrArray *dicts, gboolean swapped,
+                              Student *out);
+gboolean write_snapshot(const char *path, const Student *records, int count,
+                        guint64 seq, int next_id, GPtrArray *const *dicts);
+
+#endif
@@ -0,0 +1,792 @@
+#include "internal.h"
+#include <fcntl.h>
+
+// ================== PERSISTENCE / JOURNAL ==================
+
+// students.dat holds a full snapshot whose header records the sequence
+// number of the last journal entry folded into it. Every mutation after that
+// is appended to students.journal, so an edit costs one small write instead
+// of a full rewrite. Once the journal grows past JOURNAL_COMPACT_THRESHOLD
+// entries a snapshot of the store is folded into students.dat and the
+// journal starts over.
+//
+// A snapshot is written to students.dat.tmp and synced, the current file is
+// kept as students.dat.prev, and the new one is renamed into place. One
+// directory sync makes both renames durable before the journal is cleared.
+// load_data falls back to students.dat.prev (plus the journal) when
+// students.dat is missing or damaged, including a block that fails its CRC.
+//
+// Nothing here touches the disk on the main thread. Mutations are encoded
+// into journal bytes and queued to a single writer thread, which owns
+// journal_fp. Appends that pile up while it is busy go out as one write and
+// one fsync; snapshots are queued in the same stream, so they land after
+// every entry they include and before every entry they do not.
+//
+// The writer copies the store for a snapshot itself, under the read locks.
+// The main thread journals a change only after making it, so every journal
+// entry records which store write it brings the journal up to; a copy is
+// taken only when no write is ahead of the journal, and is stamped with
+// that entry's sequence number.
+
+typedef struct {
+    guint32 magic;
+    guint32 op;
+    guint64 seq;
+    gint32 id;      // Record id (a store position in JRN2/JRNL entries)
+    guint32 crc;    // CRC-32C of this header (crc zeroed) and the payload
+} JournalEntryHeader;
+
+// Payload of JOURNAL_OP_DICT. Written ahead of the first record entry that
+// uses a new code, so replay rebuilds the dictionaries with the same codes.
+typedef struct {
+    guint32 field;
+    guint32 code;
+    char value[DICT_MAX_LENGTH];
+} JournalDictEntry;
+
+typedef union {
+    Student student;
+    StudentV1 v1;
+    JournalDictEntry dict;
+} JournalPayload;
+
+// Replaying a journal on top of students.dat.prev, whose dictionaries can
+// be shorter than the ones the journal's codes were assigned against.
+// Dictionaries only grow, so codes the previous generation has mean the
+// same; the journal's own dictionary strings are interned afresh.
+typedef struct {
+    GArray *codes[DICT_FIELDS];  // Journal code -> local code + 1, 0 if unseen
+    int shared[DICT_FIELDS];     // Codes below this mean the same either way
+    int blanked;                 // Names known to neither, left empty
+} JournalRemap;
+
+typedef struct {
+    Student *records;
+    int count;
+    guint64 seq;
+    int next_id;
+    GPtrArray *dicts[DICT_FIELDS];
+} CompactionJob;
+
+typedef enum {
+    PERSIST_APPEND,    // Journal bytes
+    PERSIST_SNAPSHOT,  // Journal bytes, then a snapshot and a fresh journal
+    PERSIST_QUIT
+} PersistKind;
+
+typedef struct {
+    PersistKind kind;
+    GByteArray *bytes;
+} PersistRequest;
+
+typedef struct {
+    gboolean ok;
+    gboolean fallback;  // The journal could not be written, save a snapshot
+    gboolean snapshot;  // This write was a snapshot
+    gboolean stale;     // The store was ahead of the journal, nothing copied
+    int done;           // Requests finished by this write
+} PersistResult;
+
+// The store as of store_writes == writes is the journal up to seq, with
+// dict_size strings per dictionary. Set by the main thread, read by the writer.
+typedef struct {
+    guint64 writes;
+    guint64 seq;
+    int dict_size[DICT_FIELDS];
+} JournalMark;
+
+FILE *journal_fp = NULL;       // Owned by the writer thread
+guint64 journal_seq = 0;       // Sequence number of the last mutation
+int journal_entries = 0;       // Entries written since the last compaction
+int journal_dict_size[DICT_FIELDS]; // Dictionary codes already queued
+JournalMark journal_mark;
+GMutex journal_mark_lock;
+
+GAsyncQueue *persist_queue = NULL;
+GThread *persist_thread = NULL;
+int persist_pending = 0;       // Requests queued but not yet on disk
+gboolean persist_failed = FALSE;
+gboolean snapshot_queued = FALSE;
+int snapshot_entries = 0;      // journal_entries the queued snapshot folds in
+int snapshot_failures = 0;     // Failed attempts since the last good snapshot
+
+static guint32 journal_entry_crc(const JournalEntryHeader *entry, const void *payload, gsize len) {
+    JournalEntryHeader h = *entry;
+    h.crc = 0;
+    guint32 crc = crc32c(0, &h, sizeof(h));
+    return crc32c(crc, payload, len);
+}
+
+static gsize journal_payload_size(const JournalEntryHeader *entry) {
+    switch (entry->op) {
+    case JOURNAL_OP_DELETE: return 0;
+    case JOURNAL_OP_DICT: return sizeof(JournalDictEntry);
+    default: return entry->magic == JOURNAL_MAGIC ? sizeof(Student) : sizeof(StudentV1);
+    }
+}
+
+// Everything in the dictionaries now is in a snapshot or the journal.
+static void journal_mark_dicts_saved() {
+    for (int f = 0; f < DICT_FIELDS; f++) journal_dict_size[f] = dict_size(f);
+}
+
+// Read the next entry and its payload. Returns FALSE at the end of the file
+// or at an entry that is torn, unrecognised or fails its CRC.
+static gboolean journal_read_entry(FILE *fp, JournalEntryHeader *entry, JournalPayload *payload,
+                                   gsize *payload_size) {
+    if (fread(entry, sizeof(*entry), 1, fp) != 1) return FALSE;
+    if (entry->magic != JOURNAL_MAGIC && entry->magic != JOURNAL_MAGIC_V3 &&
+        entry->magic != JOURNAL_MAGIC_V2 && entry->magic != JOURNAL_MAGIC_V1) {
+        return FALSE;
+    }
+    *payload_size = journal_payload_size(entry);
+    if (*payload_size > 0 && fread(payload, *payload_size, 1, fp) != 1) return FALSE;
+    return entry->magic == JOURNAL_MAGIC_V1 ||
+           journal_entry_crc(entry, payload, *payload_size) == entry->crc;
+}
+
+static void journal_remap_init(JournalRemap *remap) {
+    for (int f = 0; f < DICT_FIELDS; f++) {
+        remap->codes[f] = g_array_new(FALSE, TRUE, sizeof(guint32));
+        remap->shared[f] = dict_size(f);
+    }
+    remap->blanked = 0;
+}
+
+static void journal_remap_clear(JournalRemap *remap) {
+    for (int f = 0; f < DICT_FIELDS; f++) g_array_free(remap->codes[f], TRUE);
+}
+
+static void journal_remap_add(JournalRemap *remap, const JournalDictEntry *d) {
+    GArray *codes = remap->codes[d->field];
+    if (d->code >= codes->len) g_array_set_size(codes, d->code + 1);
+    g_array_index(codes, guint32, d->code) = (guint32)dict_intern(d->field, d->value) + 1;
+}
+
+static guint16 journal_remap_code(JournalRemap *remap, DictField field, guint16 code) {
+    GArray *codes = remap->codes[field];
+    if (code < codes->len && g_array_index(codes, guint32, code)) {
+        return (guint16)(g_array_index(codes, guint32, code) - 1);
+    }
+    if (code < remap->shared[field]) return code;
+    remap->blanked++;
+    return 0;
+}
+
+static void journal_remap_student(JournalRemap *remap, Student *student) {
+    student->branch = journal_remap_code(remap, DICT_BRANCH, student->branch);
+    student->program = journal_remap_code(remap, DICT_PROGRAM, student->program);
+    student->gender = journal_remap_code(remap, DICT_GENDER, student->gender);
+    for (int j = 0; j < 6; j++) {
+        student->subjects[j].subject_name = journal_remap_code(remap, DICT_SUBJECT, student->subjects[j].subject_name);
+    }
+}
+
+// Apply one journal file on top of the store. Entries at or below base_seq
+// are already part of the snapshot and are skipped. Dictionary codes go
+// through remap when it is set. Sets *outdated if any entry was from an
+// older journal format (by position, or StudentV1 records). Returns FALSE
+// if the file ends in a torn or unrecognised entry, or if entries had to
+// be discarded.
+static gboolean replay_journal(const char *path, guint64 base_seq, JournalRemap *remap, gboolean *outdated) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return TRUE;
+
+    gboolean clean = TRUE;
+    JournalEntryHeader entry;
+    JournalPayload payload;
+    gsize payload_size;
+    Student student;
+
+    long good_end = 0;
+
+    while (journal_read_entry(fp, &entry, &payload, &payload_size)) {
+        good_end = ftell(fp);
+        if (entry.seq > journal_seq) journal_seq = entry.seq;
+        journal_entries++;
+        if (entry.seq <= base_seq) continue;
+
+        if (entry.op == JOURNAL_OP_DICT) {
+            JournalDictEntry *d = &payload.dict;
+            d->value[sizeof(d->value) - 1] = '\0';
+            if (d->field < DICT_FIELDS && d->code < DICT_FULL && remap) {
+                journal_remap_add(remap, d);
+                continue;
+            }
+            // Codes must arrive in order; anything else means a lost entry,
+            // and the records after it cannot be read
+            if (d->field >= DICT_FIELDS || (int)d->code != dict_size(d->field)) {
+                int discarded = 0;
+                do {
+                    if (entry.seq > base_seq) discarded++;
+                } while (journal_read_entry(fp, &entry, &payload, &payload_size));
+                g_printerr("Warning: %s has a dictionary entry out of order, discarded %d entries from there on\n",
+                           path, discarded);
+                clean = FALSE;
+                break;
+            }
+            dict_push(d->field, d->value);
+            continue;
+        }
+
+        if (entry.magic == JOURNAL_MAGIC) {
+            student = payload.student;
+            if (remap && payload_size > 0) journal_remap_student(remap, &student);
+        } else {
+            *outdated = TRUE;
+            if (payload_size > 0) student_from_v1(&payload.v1, &student);
+        }
+        if (payload_size > 0 && !student_codes_valid(&student)) {
+            g_printerr("Warning: %s entry %" G_GUINT64_FORMAT " has more names than fit, skipped\n",
+                       path, entry.seq);
+            continue;
+        }
+
+        // Older entries name a position among the live records
+        int id = entry.id;
+        if (entry.magic == JOURNAL_MAGIC_V2 || entry.magic == JOURNAL_MAGIC_V1) {
+            Student *target = store_get(&store, store_slot_at(&store, entry.id));
+            id = target ? target->id : -1;
+            if (entry.op == JOURNAL_OP_INSERT) student.id = 0;
+        }
+
+        switch (entry.op) {
+        case JOURNAL_OP_INSERT:
+            store_insert(&store, &student);
+            break;
+        case JOURNAL_OP_UPDATE:
+            store_update(&store, id, &student);
+            break;
+        case JOURNAL_OP_DELETE:
+            store_remove(&store, id);
+            break;
+        default:
+            clean = FALSE;
+            break;
+        }
+    }
+
+    // Trailing bytes that do not form a whole, valid entry are a torn write
+    if (clean && fseek(fp, 0, SEEK_END) == 0 && ftell(fp) != good_end) {
+        clean = FALSE;
+    }
+
+    fclose(fp);
+    return clean;
+}
+
+// Check a journal file without applying it. Returns FALSE if it ends in a
+// torn or unrecognised entry; *entries counts the good ones.
+gboolean journal_verify(const char *path, int *entries) {
+    *entries = 0;
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return TRUE;
+
+    JournalEntryHeader entry;
+    JournalPayload payload;
+    gsize payload_size;
+    long good_end = 0;
+    while (journal_read_entry(fp, &entry, &payload, &payload_size)) {
+        good_end = ftell(fp);
+        (*entries)++;
+    }
+    gboolean clean = fseek(fp, 0, SEEK_END) == 0 && ftell(fp) == good_end;
+    fclose(fp);
+    return clean;
+}
+
+// Encode an entry for every dictionary string not yet queued.
+static void journal_encode_dicts(GByteArray *bytes) {
+    for (int f = 0; f < DICT_FIELDS; f++) {
+        for (; journal_dict_size[f] < dict_size(f); journal_dict_size[f]++) {
+            JournalDictEntry d;
+            memset(&d, 0, sizeof(d));
+            d.field = f;
+            d.code = journal_dict_size[f];
+            g_strlcpy(d.value, dict_name(f, d.code), sizeof(d.value));
+
+            JournalEntryHeader entry = { JOURNAL_MAGIC, JOURNAL_OP_DICT, ++journal_seq, 0, 0 };
+            entry.crc = journal_entry_crc(&entry, &d, sizeof(d));
+            g_byte_array_append(bytes, (const guint8 *)&entry, sizeof(entry));
+            g_byte_array_append(bytes, (const guint8 *)&d, sizeof(d));
+            journal_entries++;
+        }
+    }
+}
+
+// Note that the store, as it is now, is the journal up to journal_seq.
+static void journal_mark_store() {
+    g_mutex_lock(&journal_mark_lock);
+    journal_mark.writes = store_writes;
+    journal_mark.seq = journal_seq;
+    memcpy(journal_mark.dict_size, journal_dict_size, sizeof(journal_mark.dict_size));
+    g_mutex_unlock(&journal_mark_lock);
+}
+
+static void compaction_job_free(CompactionJob *job) {
+    g_free(job->records);
+    for (int f = 0; f < DICT_FIELDS; f++) g_ptr_array_unref(job->dicts[f]);
+    g_free(job);
+}
+
+static void persist_request_free(PersistRequest *request) {
+    if (request->bytes) g_byte_array_unref(request->bytes);
+    g_free(request);
+}
+
+static void persist_snapshot();
+
+static gboolean persist_done(gpointer data) {
+    PersistResult *result = data;
+    persist_pending -= result->done;
+    if (result->snapshot) {
+        snapshot_queued = FALSE;
+        if (result->ok) {
+            // Only entries queued after the snapshot are left in the journal
+            journal_entries -= snapshot_entries;
+            snapshot_failures = 0;
+        } else if (!result->stale) {
+            snapshot_failures++;
+        }
+    }
+    // A later good append clears an earlier failed one, but not a snapshot
+    // that has yet to be written
+    if (!result->stale) persist_failed = !result->ok || snapshot_failures > 0;
+    if (core_hooks.persist_changed) core_hooks.persist_changed();
+
+    if (result->fallback) {
+        save_data();
+    } else if (result->stale) {
+        // Nothing was written; the store is caught up with the journal now
+        persist_snapshot();
+    } else if (result->snapshot && !result->ok) {
+        // Retry a few times, then leave it to the next change; the journal
+        // still holds everything until a snapshot succeeds
+        if (snapshot_failures < PERSIST_SNAPSHOT_RETRIES) {
+            persist_snapshot();
+        } else {
+            g_printerr("Error: could not write %s after %d attempts\n", FILE_NAME, snapshot_failures);
+        }
+    }
+    g_free(result);
+    return G_SOURCE_REMOVE;
+}
+
+static void persist_report(gboolean ok, gboolean fallback, PersistKind kind, gboolean stale, int done) {
+    PersistResult *result = g_new(PersistResult, 1);
+    result->ok = ok;
+    result->fallback = fallback;
+    result->snapshot = kind == PERSIST_SNAPSHOT;
+    result->stale = stale;
+    result->done = done;
+    g_idle_add(persist_done, result);
+}
+
+static gboolean journal_write_bytes(const GByteArray *bytes) {
+    if (bytes->len == 0) return TRUE;
+    TRACE_BEGIN(span);
+    if (!journal_fp) journal_fp = fopen(JOURNAL_FILE_NAME, "ab");
+    gboolean ok = journal_fp && fwrite(bytes->data, 1, bytes->len, journal_fp) == bytes->len &&
+                  fflush(journal_fp) == 0 && g_fsync(fileno(journal_fp)) == 0;
+    TRACE_END(span, "journal_write", TRACE_IO);
+    return ok;
+}
+
+// Make renames in the data directory durable. Windows cannot open a
+// directory for syncing; its renames go through the file system journal.
+static gboolean sync_directory() {
+#ifdef G_OS_WIN32
+    return TRUE;
+#else
+    char *dir = g_path_get_dirname(FILE_NAME);
+    int fd = g_open(dir, O_RDONLY, 0);
+    g_free(dir);
+    if (fd < 0) return FALSE;
+    gboolean ok = g_fsync(fd) == 0;
+    g_close(fd, NULL);
+    return ok;
+#endif
+}
+
+// Copy the store for a snapshot, on the writer thread. Returns NULL when a
+// store write is not in the journal yet; the main thread then queues the
+// snapshot again.
+static CompactionJob *persist_copy_store() {
+    g_rw_lock_reader_lock(&store_lock);
+    g_mutex_lock(&journal_mark_lock);
+    JournalMark mark = journal_mark;
+    g_mutex_unlock(&journal_mark_lock);
+    if (mark.writes != store_writes) {
+        g_rw_lock_reader_unlock(&store_lock);
+        return NULL;
+    }
+
+    CompactionJob *job = g_new0(CompactionJob, 1);
+    job->seq = mark.seq;
+    job->next_id = store.next_id;
+    job->records = store_copy_live(&store, &job->count);
+    g_rw_lock_reader_lock(&dict_lock);
+    for (int f = 0; f < DICT_FIELDS; f++) {
+        // Strings added since are journaled after seq, and replay adds them
+        job->dicts[f] = dict_copy(f);
+        g_ptr_array_set_size(job->dicts[f], mark.dict_size[f]);
+    }
+    g_rw_lock_reader_unlock(&dict_lock);
+    g_rw_lock_reader_unlock(&store_lock);
+    return job;
+}
+
+// Snapshot to a temporary file, sync it, then rename it over students.dat.
+static gboolean persist_write_snapshot(const CompactionJob *job) {
+    if (!write_snapshot(FILE_NAME ".tmp", job->records, job->count, job->seq, job->next_id, job->dicts)) {
+        g_unlink(FILE_NAME ".tmp");
+        return FALSE;
+    }
+    // Fails harmlessly when there is no current generation yet
+    g_rename(FILE_NAME, FILE_NAME ".prev");
+    if (g_rename(FILE_NAME ".tmp", FILE_NAME) != 0 || !sync_directory()) return FALSE;
+
+    // Everything in the journals is in the snapshot now
+    if (journal_fp) fclose(journal_fp);
+    journal_fp = fopen(JOURNAL_FILE_NAME, "wb");
+    g_unlink(JOURNAL_FILE_NAME ".old");
+    return TRUE;
+}
+
+static gpointer persist_thread_main(gpointer data) {
+    PersistRequest *next = NULL;
+    trace_name_thread("persist");
+
+    for (;;) {
+        PersistRequest *request = next ? next : g_async_queue_pop(persist_queue);
+        next = NULL;
+        if (request->kind == PERSIST_QUIT) {
+            persist_request_free(request);
+            break;
+        }
+
+        // Fold appends that queued up behind this one into the same write
+        int done = 1;
+        while (request->kind == PERSIST_APPEND &&
+               (next = g_async_queue_try_pop(persist_queue)) && next->kind == PERSIST_APPEND) {
+            g_byte_array_append(request->bytes, next->bytes->data, next->bytes->len);
+            persist_request_free(next);
+            next = NULL;
+            done++;
+        }
+
+        gboolean appended = journal_write_bytes(request->bytes);
+        gboolean ok = appended;
+        gboolean stale = FALSE;
+        if (request->kind == PERSIST_SNAPSHOT) {
+            TRACE_BEGIN(copy_span);
+            CompactionJob *job = persist_copy_store();
+            TRACE_END(copy_span, "snapshot_copy", TRACE_IO);
+            stale = job == NULL;
+            if (job) {
+                TRACE_BEGIN(span);
+                ok = persist_write_snapshot(job);
+                TRACE_END(span, "snapshot_write", TRACE_IO);
+                if (!ok) g_printerr("Warning: writing %s failed, keeping journal\n", FILE_NAME);
+                compaction_job_free(job);
+            }
+        } else if (!appended) {
+            g_printerr("Warning: writing %s failed\n", JOURNAL_FILE_NAME);
+            if (journal_fp) fclose(journal_fp);
+            journal_fp = NULL;
+        }
+        persist_report(ok && !stale, request->kind == PERSIST_APPEND && !appended, request->kind, stale, done);
+        persist_request_free(request);
+    }
+
+    if (journal_fp) fclose(journal_fp);
+    journal_fp = NULL;
+    return NULL;
+}
+
+static void persist_push(PersistKind kind, GByteArray *bytes) {
+    if (!persist_queue) {
+        persist_queue = g_async_queue_new();
+        persist_thread = g_thread_new("persist", persist_thread_main, NULL);
+    }
+    PersistRequest *request = g_new0(PersistRequest, 1);
+    request->kind = kind;
+    request->bytes = bytes;
+    if (kind != PERSIST_QUIT) {
+        persist_pending++;
+        if (core_hooks.persist_changed) core_hooks.persist_changed();
+    }
+    g_async_queue_push(persist_queue, request);
+}
+
+// Write out everything still queued and stop the writer thread.
+void persist_shutdown() {
+    if (!persist_thread) return;
+    persist_push(PERSIST_QUIT, NULL);
+    g_thread_join(persist_thread);
+    persist_thread = NULL;
+    g_async_queue_unref(persist_queue);
+    persist_queue = NULL;
+}
+
+// Queue a snapshot of the store; the writer copies it when it gets there,
+// so one already queued covers later changes too. Dictionary strings not
+// yet in the journal go ahead of it, so the journal stays complete if the
+// snapshot cannot be written.
+static void persist_snapshot() {
+    if (snapshot_queued) return;
+#ifdef G_OS_WIN32
+    store_release_mapping(&store);
+#endif
+    GByteArray *bytes = g_byte_array_new();
+    journal_encode_dicts(bytes);
+    journal_mark_store();
+
+    snapshot_queued = TRUE;
+    snapshot_entries = journal_entries;
+    persist_push(PERSIST_SNAPSHOT, bytes);
+}
+
+// Fold the journal into students.dat once it has grown long enough.
+void journal_compact_async() {
+    persist_snapshot();
+}
+
+static void journal_encode_entry(GByteArray *bytes, JournalOp op, int id, const Student *student) {
+    JournalEntryHeader entry = { JOURNAL_MAGIC, op, ++journal_seq, id, 0 };
+    gsize payload_size = journal_payload_size(&entry);
+    entry.crc = journal_entry_crc(&entry, student, payload_size);
+    g_byte_array_append(bytes, (const guint8 *)&entry, sizeof(entry));
+    if (payload_size > 0) {
+        g_byte_array_append(bytes, (const guint8 *)student, payload_size);
+    }
+}
+
+// Record one mutation. id is the record the operation applied to; student
+// is the new record contents (ignored for deletes).
+void journal_append(JournalOp op, int id, const Student *student) {
+    GByteArray *bytes = g_byte_array_new();
+
+    // New dictionary strings go first so the record's codes resolve on replay
+    journal_encode_dicts(bytes);
+    journal_encode_entry(bytes, op, id, student);
+    persist_push(PERSIST_APPEND, bytes);
+    journal_mark_store();
+
+    if (++journal_entries >= JOURNAL_COMPACT_THRESHOLD) {
+        journal_compact_async();
+    }
+}
+
+// Record n inserted records as one write, for bulk imports. A large batch
+// goes past the threshold, and the snapshot it queues folds it in.
+void journal_append_inserts(const Student *students, int n) {
+    if (n <= 0) return;
+    GByteArray *bytes = g_byte_array_sized_new((guint)MIN((gsize)n * (sizeof(JournalEntryHeader) + sizeof(Student)),
+                                                          G_MAXUINT));
+    journal_encode_dicts(bytes);
+    for (int i = 0; i < n; i++) journal_encode_entry(bytes, JOURNAL_OP_INSERT, students[i].id, &students[i]);
+    persist_push(PERSIST_APPEND, bytes);
+    journal_mark_store();
+
+    journal_entries += n;
+    if (journal_entries >= JOURNAL_COMPACT_THRESHOLD) {
+        journal_compact_async();
+    }
+}
+
+static gboolean load_legacy(const char *contents, gsize length, guint64 *base_seq) {
+    int count = 0;
+    if (length >= sizeof(int)) memcpy(&count, contents, sizeof(int));
+
+    gsize records_end = sizeof(int) + (gsize)MAX(count, 0) * sizeof(StudentV1);
+    if (count < 0 || records_end > length || !store_reserve(&store, count)) return FALSE;
+
+    for (int i = 0; i < count; i++) {
+        StudentV1 v1;
+        memcpy(&v1, contents + sizeof(int) + (gsize)i * sizeof(StudentV1), sizeof(v1));
+        if (!student_from_v1(&v1, &store.records[i])) {
+            g_printerr("Error: %s has more distinct names than fit\n", FILE_NAME);
+            return FALSE;
+        }
+    }
+    store.count = count;
+
+    // Snapshots written before the journal existed have no trailer
+    LegacyTrailer trailer;
+    if (length - records_end >= sizeof(trailer)) {
+        memcpy(&trailer, contents + records_end, sizeof(trailer));
+        if (trailer.magic == LEGACY_TRAILER_MAGIC) *base_seq = trailer.seq;
+    }
+    return TRUE;
+}
+
+// Load students.dat into the store. Block CRCs are checked before the
+// store takes any records, and a file that fails them is INVALID, so
+// load_data falls back to the previous generation. Native snapshots are
+// then served in place from a private mapping; set STUDENTS_NO_MMAP to
+// always copy records onto the heap.
+static FileLayout load_snapshot(const char *path, guint64 *base_seq, int *next_id) {
+    GMappedFile *mapping = g_mapped_file_new(path, TRUE, NULL);
+    if (!mapping) return FILE_LAYOUT_EMPTY;
+
+    gsize length = g_mapped_file_get_length(mapping);
+    const char *contents = g_mapped_file_get_contents(mapping);
+    FileHeader header;
+    FileField *fields = NULL;
+    GPtrArray *dicts = NULL;
+    gboolean swapped = FALSE;
+    FileLayout layout = file_parse(contents, length, &header, &fields, &dicts, &swapped);
+
+    if ((layout == FILE_LAYOUT_NATIVE || layout == FILE_LAYOUT_FOREIGN) &&
+        header.record_count > G_MAXINT) {
+        layout = FILE_LAYOUT_INVALID;
+    }
+
+    if (layout == FILE_LAYOUT_NATIVE || layout == FILE_LAYOUT_FOREIGN) {
+        TRACE_BEGIN(span);
+        gint64 bad = file_verify_blocks(contents, &header, swapped);
+        TRACE_END(span, "verify_snapshot", TRACE_IO);
+        if (bad >= 0) {
+            g_printerr("Error: %s block %" G_GINT64_FORMAT " failed its checksum\n", path, bad);
+            layout = FILE_LAYOUT_INVALID;
+        }
+    }
+
+    // Take the file's dictionaries as they are, so codes in the records and
+    // the journal keep their meaning. Converted fields re-intern through them.
+    for (int f = 0; f < DICT_FIELDS; f++) {
+        if (layout != FILE_LAYOUT_INVALID && dicts && f < (int)dicts->len) {
+            GPtrArray *strings = g_ptr_array_index(dicts, f);
+            dict_load(f, (const char *const *)strings->pdata, strings->len);
+        } else {
+            dict_reset(f);
+        }
+    }
+
+    gboolean in_place = layout == FILE_LAYOUT_NATIVE && !g_getenv("STUDENTS_NO_MMAP");
+
+    if (layout == FILE_LAYOUT_NATIVE || layout == FILE_LAYOUT_FOREIGN) {
+        *next_id = (int)MIN(header.next_id, (guint32)G_MAXINT);
+    }
+
+    switch (layout) {
+    case FILE_LAYOUT_NATIVE:
+        *base_seq = header.seq;
+        if (in_place) {
+            store_attach_mapping(&store, mapping, header.records_offset, (int)header.record_count);
+        } else if (store_reserve(&store, (int)header.record_count)) {
+            memcpy(store.records, contents + header.records_offset,
+                   (gsize)header.record_count * sizeof(Student));
+            store.count = (int)header.record_count;
+        }
+        break;
+    case FILE_LAYOUT_FOREIGN:
+        *base_seq = header.seq;
+        if (store_reserve(&store, (int)header.record_count)) {
+            if (!file_convert_records(contents, &header, fields, dicts, swapped, store.records)) {
+                g_printerr("Error: %s has more distinct names than fit\n", path);
+                layout = FILE_LAYOUT_INVALID;
+                break;
+            }
+            store.count = (int)header.record_count;
+        }
+        break;
+    case FILE_LAYOUT_LEGACY:
+        if (!load_legacy(contents, length, base_seq)) layout = FILE_LAYOUT_INVALID;
+        break;
+    default:
+        break;
+    }
+
+    g_free(fields);
+    if (dicts) g_ptr_array_unref(dicts);
+    g_mapped_file_unref(mapping);
+    return layout;
+}
+
+void load_data() {
+    TRACE_BEGIN(span);
+    guint64 base_seq = 0;
+    int next_id = 0;
+    FileLayout layout = load_snapshot(FILE_NAME, &base_seq, &next_id);
+
+    // Left behind by a save that never finished
+    g_unlink(FILE_NAME ".tmp");
+
+    if (layout == FILE_LAYOUT_INVALID) {
+        // Keep the damaged file out of the way of the next snapshot
+        g_printerr("Error: %s is damaged or from a newer version, moved to %s\n",
+                   FILE_NAME, FILE_NAME ".bad");
+        store_clear(&store);
+        g_rename(FILE_NAME, FILE_NAME ".bad");
+    }
+
+    // Without a usable snapshot, start from the previous generation. The
+    // journal still covers it unless a later snapshot had been completed.
+    gboolean recovered = FALSE;
+    JournalRemap remap;
+    if ((layout == FILE_LAYOUT_INVALID || layout == FILE_LAYOUT_EMPTY) &&
+        g_file_test(FILE_NAME ".prev", G_FILE_TEST_EXISTS)) {
+        base_seq = 0;
+        next_id = 0;
+        layout = load_snapshot(FILE_NAME ".prev", &base_seq, &next_id);
+        if (layout == FILE_LAYOUT_INVALID) {
+            g_printerr("Error: %s is damaged as well\n", FILE_NAME ".prev");
+            store_clear(&store);
+        } else {
+            g_printerr("Warning: recovered records from %s\n", FILE_NAME ".prev");
+            recovered = TRUE;
+            journal_remap_init(&remap);
+        }
+    }
+    journal_seq = base_seq;
+    gboolean renumbered = store_index_ids(&store, next_id);
+
+    // A leftover .old journal means a compaction was interrupted
+    gboolean interrupted = g_file_test(JOURNAL_FILE_NAME ".old", G_FILE_TEST_EXISTS);
+    gboolean outdated = FALSE;
+    gboolean clean = replay_journal(JOURNAL_FILE_NAME ".old", base_seq, recovered ? &remap : NULL, &outdated);
+    clean = replay_journal(JOURNAL_FILE_NAME, base_seq, recovered ? &remap : NULL, &outdated) && clean;
+    if (recovered) {
+        if (remap.blanked > 0) {
+            g_printerr("Warning: %d names in the journal were only in the damaged %s and were left blank\n",
+                       remap.blanked, FILE_NAME);
+        }
+        journal_remap_clear(&remap);
+    }
+    journal_mark_dicts_saved();
+
+    // Fold everything into a fresh snapshot so the next rotation cannot
+    // clobber unfolded entries, a torn tail is not appended after, and
+    // legacy or foreign files, older journals and renumbered ids are
+    // upgraded to the current format
+    if (interrupted || recovered || !clean || renumbered || outdated ||
+        layout == FILE_LAYOUT_LEGACY || layout == FILE_LAYOUT_FOREIGN) {
+        save_data();
+    }
+
+    store_compact(&store);
+    reg_index_rebuild();
+    search_index_rebuild();
+    columns_rebuild();
+    stats_rebuild();
+
+    // Load default subject names if available
+    if (store.count > 0) {
+         for(int i=0; i<6; i++) {
+             const char *subject_name = dict_name(DICT_SUBJECT, store.records[0].subjects[i].subject_name);
+             if(strlen(subject_name) > 0) {
+                 strncpy(default_subject_names[i], subject_name, 49);
+             }
+         }
+    }
+    TRACE_END(span, "load_data", TRACE_IO);
+}
+
+// Write a full snapshot and start a fresh journal, on the writer thread.
+void save_data() {
+    TRACE_BEGIN(span);
+    persist_snapshot();
+    TRACE_END(span, "save_data", TRACE_IO);
+}
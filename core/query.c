@@ -0,0 +1,434 @@
+#include "internal.h"
+#include <ctype.h>
+
+// ================== QUERY ==================
+
+// The search box takes plain text, matched against names and reg numbers
+// as before, mixed with field filters that must all hold:
+//
+//     branch=CSE gpa>=8 age<21 gender=Male,Other -program=M.Tech m3>60
+//
+// Fields are name, reg, phone, branch, program, gender, age, gpa and the
+// subject marks, as m1..m6 or by default subject name. Operators are
+// = != < <= > >= for numbers, = and != for the rest, and ~ (contains) for
+// name, reg and phone. A value may be "quoted", after = or != a comma list
+// matches any of its values, and a leading - negates a term.
+//
+// A query compiles to a plan of terms ordered cheapest first and evaluates
+// to a bitset over slots, starting from the live ones. Plain text and reg
+// numbers come from the search index; numbers and categories are branch-free
+// scans of the COLUMNS arrays, categories comparing dictionary codes as
+// integers; names and phones are checked only for records still in the set.
+// Words of the bitset that are already empty are skipped, so later terms
+// touch little.
+
+typedef enum {
+    QUERY_FIELD_TEXT,  // Plain text: reg prefix or name substring
+    QUERY_FIELD_NAME,
+    QUERY_FIELD_REG,
+    QUERY_FIELD_PHONE,
+    QUERY_FIELD_BRANCH,
+    QUERY_FIELD_PROGRAM,
+    QUERY_FIELD_GENDER,
+    QUERY_FIELD_AGE,
+    QUERY_FIELD_GPA,
+    QUERY_FIELD_MARKS
+} QueryField;
+
+typedef enum {
+    QUERY_EQ,
+    QUERY_NE,
+    QUERY_LT,
+    QUERY_LE,
+    QUERY_GT,
+    QUERY_GE,
+    QUERY_CONTAINS
+} QueryOp;
+
+typedef struct {
+    QueryField field;
+    QueryOp op;
+    int subject;       // Marks column for QUERY_FIELD_MARKS
+    gboolean negate;
+    double number;
+    char *text;        // Lowercased value of a text, name, reg or phone term
+    guint64 *codes;    // Accepted dictionary codes of a category term
+    int code;          // The only accepted code, or -1
+    int cost;          // 0 index lookup, 1 column scan, 2 record check
+} QueryTerm;
+
+struct Query {
+    QueryTerm *terms;
+    int count;
+};
+
+#define QUERY_CODE_WORDS ((G_MAXUINT16 + 1) / 64)
+
+static const struct {
+    const char *name;
+    QueryField field;
+} query_fields[] = {
+    { "name", QUERY_FIELD_NAME },
+    { "reg", QUERY_FIELD_REG },
+    { "regno", QUERY_FIELD_REG },
+    { "phone", QUERY_FIELD_PHONE },
+    { "branch", QUERY_FIELD_BRANCH },
+    { "program", QUERY_FIELD_PROGRAM },
+    { "gender", QUERY_FIELD_GENDER },
+    { "age", QUERY_FIELD_AGE },
+    { "gpa", QUERY_FIELD_GPA },
+};
+
+static gboolean query_field_lookup(const char *name, QueryField *field, int *subject) {
+    for (gsize i = 0; i < G_N_ELEMENTS(query_fields); i++) {
+        if (g_ascii_strcasecmp(name, query_fields[i].name) == 0) {
+            *field = query_fields[i].field;
+            return TRUE;
+        }
+    }
+    for (int j = 0; j < 6; j++) {
+        char short_name[8];
+        snprintf(short_name, sizeof(short_name), "m%d", j + 1);
+        if (g_ascii_strcasecmp(name, short_name) == 0 || g_ascii_strcasecmp(name, default_subject_names[j]) == 0) {
+            *field = QUERY_FIELD_MARKS;
+            *subject = j;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+// Operator at the start of s, returning its length, or 0.
+static int query_parse_op(const char *s, QueryOp *op) {
+    static const struct { const char *text; QueryOp op; } ops[] = {
+        { ">=", QUERY_GE }, { "<=", QUERY_LE }, { "!=", QUERY_NE }, { "==", QUERY_EQ },
+        { "=", QUERY_EQ }, { ":", QUERY_EQ }, { "<", QUERY_LT }, { ">", QUERY_GT }, { "~", QUERY_CONTAINS },
+    };
+    for (gsize i = 0; i < G_N_ELEMENTS(ops); i++) {
+        gsize len = strlen(ops[i].text);
+        if (strncmp(s, ops[i].text, len) == 0) {
+            *op = ops[i].op;
+            return (int)len;
+        }
+    }
+    return 0;
+}
+
+static DictField query_dict_field(QueryField field) {
+    return field == QUERY_FIELD_BRANCH ? DICT_BRANCH : field == QUERY_FIELD_PROGRAM ? DICT_PROGRAM : DICT_GENDER;
+}
+
+void query_free(Query *query) {
+    if (!query) return;
+    for (int i = 0; i < query->count; i++) {
+        g_free(query->terms[i].text);
+        g_free(query->terms[i].codes);
+    }
+    g_free(query->terms);
+    g_free(query);
+}
+
+// Fill in term for field, op and the unquoted value. Returns an error
+// message, or NULL.
+static char *query_compile_term(QueryTerm *term, const char *field_name, const char *value) {
+    gboolean numeric = term->field == QUERY_FIELD_AGE || term->field == QUERY_FIELD_GPA ||
+                       term->field == QUERY_FIELD_MARKS;
+    gboolean category = term->field >= QUERY_FIELD_BRANCH && term->field <= QUERY_FIELD_GENDER;
+
+    if (numeric) {
+        char *end;
+        term->number = g_ascii_strtod(value, &end);
+        if (*value == '\0' || *end != '\0') return g_strdup_printf("%s needs a number", field_name);
+        if (term->op == QUERY_CONTAINS) return g_strdup_printf("%s cannot use ~", field_name);
+        term->cost = 1;
+        return NULL;
+    }
+    if (term->op != QUERY_EQ && term->op != QUERY_NE && (category || term->op != QUERY_CONTAINS)) {
+        return g_strdup_printf("%s only supports %s", field_name, category ? "= and !=" : "=, != and ~");
+    }
+    // Inequality is a negated equality from here on
+    if (term->op == QUERY_NE) {
+        term->op = QUERY_EQ;
+        term->negate = !term->negate;
+    }
+
+    if (category) {
+        DictField dict = query_dict_field(term->field);
+        char **values = g_strsplit(value, ",", -1);
+        term->codes = g_new0(guint64, QUERY_CODE_WORDS);
+        term->code = -1;
+        int accepted = 0;
+        for (int code = 0; code < dict_size(dict); code++) {
+            for (int v = 0; values[v]; v++) {
+                if (g_ascii_strcasecmp(dict_name(dict, code), g_strstrip(values[v])) != 0) continue;
+                term->codes[code / 64] |= G_GUINT64_CONSTANT(1) << (code % 64);
+                term->code = accepted++ == 0 ? code : -1;
+                break;
+            }
+        }
+        g_strfreev(values);
+        // Nothing matches a name the dictionary has never seen
+        if (accepted == 0) term->code = G_MAXUINT16 + 1;
+        term->cost = 1;
+        return NULL;
+    }
+
+    term->text = g_ascii_strdown(value, -1);
+    term->cost = term->field == QUERY_FIELD_REG && term->op == QUERY_EQ ? 0 : 2;
+    return NULL;
+}
+
+// Compile the search box text into a plan. Returns NULL and sets *error on
+// a malformed filter.
+Query *query_compile(const char *text, char **error) {
+    Query *query = g_new0(Query, 1);
+    GArray *terms = g_array_new(FALSE, TRUE, sizeof(QueryTerm));
+    GString *plain = g_string_new(NULL);
+    *error = NULL;
+
+    const char *p = text;
+    while (*p && !*error) {
+        while (g_ascii_isspace(*p)) p++;
+        if (!*p) break;
+
+        // A token runs to the next space outside quotes
+        const char *start = p;
+        gboolean quoted = FALSE;
+        for (; *p && (quoted || !g_ascii_isspace(*p)); p++) {
+            if (*p == '"') quoted = !quoted;
+        }
+        char *token = g_strndup(start, p - start);
+
+        QueryTerm term = { 0 };
+        const char *body = token;
+        if (body[0] == '-' && body[1]) {
+            term.negate = TRUE;
+            body++;
+        }
+
+        // field op value, where field is a known name
+        gsize field_len = strspn(body, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_");
+        char *field_name = g_strndup(body, field_len);
+        int op_len = field_len > 0 ? query_parse_op(body + field_len, &term.op) : 0;
+        if (op_len > 0 && query_field_lookup(field_name, &term.field, &term.subject)) {
+            char *value = g_strdup(body + field_len + op_len);
+            gsize len = strlen(value);
+            if (len >= 2 && value[0] == '"' && value[len - 1] == '"') {
+                memmove(value, value + 1, len - 2);
+                value[len - 2] = '\0';
+            }
+            *error = query_compile_term(&term, field_name, value);
+            if (!*error) g_array_append_val(terms, term);
+            g_free(value);
+        } else if (term.negate) {
+            term.field = QUERY_FIELD_TEXT;
+            term.text = g_ascii_strdown(body, -1);
+            g_array_append_val(terms, term);
+        } else {
+            // Plain words stay one phrase, as the search box always matched
+            if (plain->len > 0) g_string_append_c(plain, ' ');
+            g_string_append(plain, token);
+        }
+        g_free(field_name);
+        g_free(token);
+    }
+
+    if (plain->len > 0) {
+        QueryTerm term = { .field = QUERY_FIELD_TEXT, .text = g_ascii_strdown(plain->str, -1) };
+        g_array_append_val(terms, term);
+    }
+    g_string_free(plain, TRUE);
+
+    query->count = terms->len;
+    query->terms = (QueryTerm *)g_array_free(terms, FALSE);
+    if (*error) {
+        query_free(query);
+        return NULL;
+    }
+
+    // Cheapest first; a stable insertion sort keeps the written order otherwise
+    for (int i = 1; i < query->count; i++) {
+        QueryTerm term = query->terms[i];
+        int j = i;
+        for (; j > 0 && query->terms[j - 1].cost > term.cost; j--) query->terms[j] = query->terms[j - 1];
+        query->terms[j] = term;
+    }
+    return query;
+}
+
+static gboolean query_compare(double x, QueryOp op, double value) {
+    switch (op) {
+    case QUERY_EQ: return x == value;
+    case QUERY_NE: return x != value;
+    case QUERY_LT: return x < value;
+    case QUERY_LE: return x <= value;
+    case QUERY_GT: return x > value;
+    default: return x >= value;
+    }
+}
+
+static gboolean query_term_matches(const QueryTerm *term, const Student *student) {
+    gboolean match;
+    const char *field = NULL;
+    switch (term->field) {
+    case QUERY_FIELD_TEXT:
+        match = search_text_matches(student, term->text, strlen(term->text));
+        break;
+    case QUERY_FIELD_NAME: field = student->name; break;
+    case QUERY_FIELD_REG: field = student->reg_num; break;
+    case QUERY_FIELD_PHONE: field = student->phone; break;
+    case QUERY_FIELD_AGE:
+        match = query_compare(student->age, term->op, term->number);
+        break;
+    case QUERY_FIELD_GPA:
+        match = query_compare(student->gpa, term->op, (float)term->number);
+        break;
+    case QUERY_FIELD_MARKS:
+        match = query_compare(student->subjects[term->subject].marks, term->op, (float)term->number);
+        break;
+    default: {
+        guint16 code = student_dict_code(student, query_dict_field(term->field));
+        match = (term->codes[code / 64] >> (code % 64)) & 1;
+    }
+    }
+    if (field) {
+        match = term->op == QUERY_CONTAINS ? ascii_contains_lower(field, term->text, strlen(term->text))
+                                           : g_ascii_strcasecmp(field, term->text) == 0;
+    }
+    return match != term->negate;
+}
+
+// Whether every term holds for student.
+gboolean query_matches(const Query *query, const Student *student) {
+    for (int i = 0; i < query->count; i++) {
+        if (!query_term_matches(&query->terms[i], student)) return FALSE;
+    }
+    return query->count > 0;
+}
+
+#define QUERY_SCAN(test) \
+    for (int b = 0; b < n; b++) mask |= (guint64)(test) << b
+
+#define QUERY_SCAN_COMPARE(column, value) \
+    switch (term->op) { \
+    case QUERY_EQ: QUERY_SCAN(column[b] == value); break; \
+    case QUERY_NE: QUERY_SCAN(column[b] != value); break; \
+    case QUERY_LT: QUERY_SCAN(column[b] < value); break; \
+    case QUERY_LE: QUERY_SCAN(column[b] <= value); break; \
+    case QUERY_GT: QUERY_SCAN(column[b] > value); break; \
+    default: QUERY_SCAN(column[b] >= value); break; \
+    }
+
+// Slots among the n starting at base that pass a column term, as a mask.
+static guint64 query_scan_word(const QueryTerm *term, int base, int n) {
+    guint64 mask = 0;
+    if (term->field == QUERY_FIELD_AGE) {
+        const int *column = columns.age + base;
+        double value = term->number;
+        QUERY_SCAN_COMPARE(column, value);
+    } else if (term->field == QUERY_FIELD_GPA || term->field == QUERY_FIELD_MARKS) {
+        const float *column = (term->field == QUERY_FIELD_GPA ? columns.gpa : columns.marks[term->subject]) + base;
+        float value = (float)term->number;
+        QUERY_SCAN_COMPARE(column, value);
+    } else {
+        const guint16 *column = columns.code[query_dict_field(term->field)] + base;
+        if (term->code >= 0) {
+            int code = term->code;
+            QUERY_SCAN(column[b] == code);
+        } else {
+            const guint64 *codes = term->codes;
+            QUERY_SCAN((codes[column[b] / 64] >> (column[b] % 64)) & 1);
+        }
+    }
+    return mask;
+}
+
+#undef QUERY_SCAN_COMPARE
+#undef QUERY_SCAN
+
+// Bitset over slots of the live records matching query, one bit per slot
+// in (store_slots + 63) / 64 words, or NULL if cancelled part way.
+guint64 *query_run(const Query *query, GCancellable *cancellable) {
+    int count = store_slots(&store);
+    int words = (count + 63) / 64;
+    guint64 *bits = g_new(guint64, MAX(words, 1));
+    for (int w = 0; w < words; w++) {
+        bits[w] = store.dead ? store_live_word(&store, w) : ~G_GUINT64_CONSTANT(0);
+    }
+    if (count % 64 && !store.dead) bits[words - 1] = (G_GUINT64_CONSTANT(1) << (count % 64)) - 1;
+
+    if (query->count == 0) memset(bits, 0, MAX(words, 1) * sizeof(guint64));
+    guint64 *hits = NULL;
+    for (int i = 0; i < query->count; i++) {
+        const QueryTerm *term = &query->terms[i];
+        if (term->cost == 0) {
+            if (!hits) hits = g_new(guint64, MAX(words, 1));
+            memset(hits, 0, MAX(words, 1) * sizeof(guint64));
+            if (term->field == QUERY_FIELD_TEXT) search_text_hits(term->text, strlen(term->text), hits, cancellable);
+            else search_reg_hits(term->text, hits, cancellable);
+            if (g_cancellable_is_cancelled(cancellable)) {
+                g_free(hits);
+                g_free(bits);
+                return NULL;
+            }
+            for (int w = 0; w < words; w++) bits[w] &= term->negate ? ~hits[w] : hits[w];
+            continue;
+        }
+
+        for (int w = 0; w < words; w++) {
+            if (w % 1024 == 0 && g_cancellable_is_cancelled(cancellable)) {
+                g_free(hits);
+                g_free(bits);
+                return NULL;
+            }
+            if (!bits[w]) continue;
+            guint64 mask = 0;
+            if (term->cost == 1) {
+                mask = query_scan_word(term, w * 64, MIN(64, count - w * 64));
+            } else {
+                for (guint64 left = bits[w]; left; left &= left - 1) {
+                    int slot = w * 64 + __builtin_ctzll(left);
+                    QueryTerm positive = *term;
+                    positive.negate = FALSE;
+                    if (query_term_matches(&positive, &store.records[slot])) mask |= G_GUINT64_CONSTANT(1) << (slot % 64);
+                }
+            }
+            bits[w] &= term->negate ? ~mask : mask;
+        }
+    }
+    g_free(hits);
+    return bits;
+}
+
+// Slots of the students matching query in ascending order. A malformed
+// filter matches nothing and sets *error.
+GArray *search_students(const char *query, char **error) {
+    GArray *result = g_array_new(FALSE, FALSE, sizeof(int));
+    Query *plan = query_compile(query, error);
+    if (!plan) return result;
+    TRACE_BEGIN(span);
+
+    guint64 *bits = query_run(plan, NULL);
+    for (int w = 0; w < (store_slots(&store) + 63) / 64; w++) {
+        for (guint64 left = bits[w]; left; left &= left - 1) {
+            int slot = w * 64 + __builtin_ctzll(left);
+            g_array_append_val(result, slot);
+        }
+    }
+    g_free(bits);
+    query_free(plan);
+    TRACE_END(span, "search_students", TRACE_SEARCH);
+    return result;
+}
+
+// Whether search_students(query) would return student, for keeping a
+// filtered view current one record at a time.
+gboolean search_matches(const Student *student, const char *query) {
+    char *error;
+    Query *plan = query_compile(query, &error);
+    g_free(error);
+    if (!plan) return FALSE;
+    gboolean match = query_matches(plan, student);
+    query_free(plan);
+    return match;
+}
@@ -0,0 +1,380 @@
+#include "internal.h"
+
+// ================== SORTING ==================
+
+// Column sorting without a GtkSortListModel, so clicking a header never
+// compares GObjects. Each sortable column has a cached permutation: the ids
+// of all live students in ascending (key, id) order, built the first time
+// the column is sorted and from then on kept current by the store on every
+// insert, edit and delete with a binary search and one memmove. Descending
+// order reads the same permutation backwards, and ids survive compaction.
+//
+// Age, GPA and the dictionary-coded branch, program and gender (ranked by
+// collating their few distinct names) are read from the COLUMNS arrays and
+// ordered with a parallel LSD radix sort, which keeps ties in the order the
+// ids arrive in: ascending slot order, or the ids' own radix passes first
+// when slots are not in id order. Names, reg numbers and phone
+// numbers get g_utf8_collate_key keys, which workers generate and sort in
+// chunks that are then merged pairwise. Comparing keys with strcmp agrees
+// with g_utf8_collate, which the incremental updates use.
+
+#define SORT_MAX_WORKERS 16
+#define SORT_RADIX_BITS 8
+#define SORT_RADIX (1 << SORT_RADIX_BITS)
+#define SORT_RADIX_PASSES (32 / SORT_RADIX_BITS)
+#define SORT_DICT_FIELD(key) ((DictField)((key) - SORT_BRANCH))
+
+GArray *sort_orders[SORT_KEYS];  // Cached permutations, NULL until first sorted
+int sort_active = -1;            // Key the table is sorted by, -1 for store order
+gboolean sort_descending = FALSE;
+
+typedef struct {
+    guint64 prefix;  // First bytes of key, big-endian, so most compares skip strcmp
+    char *key;       // Collation key
+    int id;
+} SortEntry;
+
+typedef struct {
+    SortKey key;
+    int begin, mid, end;      // Slot range to gather, or entry range to sort or merge
+    int offset;               // Live position of the first slot in the gather range
+    const guint32 *ranks;     // Collation rank of each dictionary code
+    guint32 *keys, *ids;      // Radix pass input
+    guint32 *keys_out, *ids_out;
+    int shift;                // Digit of this radix pass
+    gboolean by_id;           // Whether the pass reads its digit from ids rather than keys
+    int count[SORT_RADIX];    // Digit histogram of the task's range, then its scatter offsets
+    SortEntry *entries, *merged;
+} SortTask;
+
+static gboolean sort_key_is_text(SortKey key) {
+    return key == SORT_NAME || key == SORT_REG || key == SORT_PHONE;
+}
+
+static const char *sort_text(SortKey key, const Student *student) {
+    switch (key) {
+    case SORT_NAME: return student->name;
+    case SORT_REG: return student->reg_num;
+    case SORT_PHONE: return student->phone;
+    case SORT_BRANCH: return dict_name(DICT_BRANCH, student->branch);
+    case SORT_PROGRAM: return dict_name(DICT_PROGRAM, student->program);
+    default: return dict_name(DICT_GENDER, student->gender);
+    }
+}
+
+// Order of two records under key, ties broken by id. This is exactly the
+// order the permutation for key is built in.
+int sort_compare(SortKey key, const Student *a, const Student *b) {
+    int c;
+    if (key == SORT_AGE) c = (a->age > b->age) - (a->age < b->age);
+    else if (key == SORT_GPA) c = (a->gpa > b->gpa) - (a->gpa < b->gpa);
+    else c = g_utf8_collate(sort_text(key, a), sort_text(key, b));
+    return c ? c : (a->id > b->id) - (a->id < b->id);
+}
+
+static SortEntry sort_entry_new(const char *text, int id) {
+    SortEntry entry = { 0, g_utf8_collate_key(text, -1), id };
+    for (int i = 0; i < 8 && entry.key[i]; i++) {
+        entry.prefix |= (guint64)(guchar)entry.key[i] << (56 - 8 * i);
+    }
+    return entry;
+}
+
+static int sort_entry_compare(const void *a, const void *b) {
+    const SortEntry *x = a, *y = b;
+    int c = (x->prefix > y->prefix) - (x->prefix < y->prefix);
+    if (c == 0) c = strcmp(x->key, y->key);
+    return c ? c : (x->id > y->id) - (x->id < y->id);
+}
+
+// Unsigned key whose order matches the column's, for the radix sort.
+static guint32 sort_radix_key(const SortTask *task, int slot) {
+    if (task->key == SORT_AGE) return (guint32)columns.age[slot] ^ 0x80000000u;
+    if (task->key == SORT_GPA) {
+        float gpa = columns.gpa[slot] + 0.0f;  // -0 sorts with +0
+        guint32 bits;
+        memcpy(&bits, &gpa, sizeof(bits));
+        return bits & 0x80000000u ? ~bits : bits | 0x80000000u;
+    }
+    return task->ranks[columns.code[SORT_DICT_FIELD(task->key)][slot]];
+}
+
+// Collation rank of every code of a dictionary field; equal names share one.
+static guint32 *sort_dict_ranks(DictField field) {
+    int n = dict_size(field);
+    SortEntry *entries = g_new(SortEntry, n);
+    for (int code = 0; code < n; code++) {
+        entries[code] = sort_entry_new(dict_name(field, code), code);
+    }
+    qsort(entries, n, sizeof(SortEntry), sort_entry_compare);
+
+    guint32 *ranks = g_new(guint32, n);
+    for (int i = 0; i < n; i++) {
+        gboolean tie = i > 0 && strcmp(entries[i].key, entries[i - 1].key) == 0;
+        ranks[entries[i].id] = tie ? ranks[entries[i - 1].id] : (guint32)i;
+    }
+    for (int i = 0; i < n; i++) g_free(entries[i].key);
+    g_free(entries);
+    return ranks;
+}
+
+static gpointer sort_gather_worker(gpointer data) {
+    SortTask *task = data;
+    int out = task->offset, start, end;
+    for (int from = task->begin; from < task->end && store_next_live_run(&store, from, &start, &end); from = end) {
+        end = MIN(end, task->end);
+        for (int slot = start; slot < end; slot++, out++) {
+            const Student *student = &store.records[slot];
+            if (sort_key_is_text(task->key)) {
+                task->entries[out] = sort_entry_new(sort_text(task->key, student), student->id);
+            } else {
+                task->keys[out] = sort_radix_key(task, slot);
+                task->ids[out] = student->id;
+            }
+        }
+    }
+    return NULL;
+}
+
+static gpointer sort_count_worker(gpointer data) {
+    SortTask *task = data;
+    const guint32 *digits = task->by_id ? task->ids : task->keys;
+    memset(task->count, 0, sizeof(task->count));
+    for (int i = task->begin; i < task->end; i++) {
+        task->count[(digits[i] >> task->shift) & (SORT_RADIX - 1)]++;
+    }
+    return NULL;
+}
+
+static gpointer sort_scatter_worker(gpointer data) {
+    SortTask *task = data;
+    const guint32 *digits = task->by_id ? task->ids : task->keys;
+    for (int i = task->begin; i < task->end; i++) {
+        int position = task->count[(digits[i] >> task->shift) & (SORT_RADIX - 1)]++;
+        task->keys_out[position] = task->keys[i];
+        task->ids_out[position] = task->ids[i];
+    }
+    return NULL;
+}
+
+static gpointer sort_chunk_worker(gpointer data) {
+    SortTask *task = data;
+    qsort(task->entries + task->begin, task->end - task->begin, sizeof(SortEntry), sort_entry_compare);
+    return NULL;
+}
+
+static gpointer sort_merge_worker(gpointer data) {
+    SortTask *task = data;
+    int a = task->begin, b = task->mid, out = task->begin;
+    while (a < task->mid && b < task->end) {
+        task->merged[out++] = sort_entry_compare(&task->entries[b], &task->entries[a]) < 0
+                              ? task->entries[b++] : task->entries[a++];
+    }
+    while (a < task->mid) task->merged[out++] = task->entries[a++];
+    while (b < task->end) task->merged[out++] = task->entries[b++];
+    return NULL;
+}
+
+static gpointer sort_release_worker(gpointer data) {
+    SortTask *task = data;
+    for (int i = task->begin; i < task->end; i++) {
+        task->ids[i] = task->entries[i].id;
+        g_free(task->entries[i].key);
+    }
+    return NULL;
+}
+
+static void sort_parallel(GThreadFunc func, SortTask *tasks, int workers) {
+    GThread *threads[SORT_MAX_WORKERS];
+    for (int w = 0; w < workers; w++) {
+        threads[w] = workers > 1 ? g_thread_new("sort", func, &tasks[w]) : NULL;
+        if (!threads[w]) func(&tasks[w]);
+    }
+    for (int w = 0; w < workers; w++) {
+        if (threads[w]) g_thread_join(threads[w]);
+    }
+}
+
+// Build the permutation for key from scratch using every core.
+GArray *sort_build(SortKey key) {
+    int n = store_count(&store);
+    int slots = store_slots(&store);
+    int workers = CLAMP((int)g_get_num_processors(), 1, SORT_MAX_WORKERS);
+    if (n < 4096) workers = 1;
+
+    GArray *order = g_array_sized_new(FALSE, FALSE, sizeof(int), MAX(n, 1));
+    g_array_set_size(order, n);
+    gboolean text = sort_key_is_text(key);
+    guint32 *ranks = !text && key != SORT_AGE && key != SORT_GPA ? sort_dict_ranks(SORT_DICT_FIELD(key)) : NULL;
+    guint32 *keys = NULL, *ids = NULL, *keys_out = NULL, *ids_out = NULL;
+    SortEntry *entries = NULL, *merged = NULL;
+    if (text) {
+        entries = g_new(SortEntry, MAX(n, 1));
+        merged = g_new(SortEntry, MAX(n, 1));
+    } else {
+        keys = g_new(guint32, MAX(n, 1));
+        ids = g_new(guint32, MAX(n, 1));
+        keys_out = g_new(guint32, MAX(n, 1));
+        ids_out = g_new(guint32, MAX(n, 1));
+    }
+
+    // Gather every live record's key; each worker writes its slot range at
+    // the range's position in the live order
+    SortTask *tasks = g_new0(SortTask, workers);
+    for (int w = 0; w < workers; w++) {
+        int begin = (int)((gint64)slots * w / workers);
+        tasks[w] = (SortTask){ .key = key, .begin = begin, .end = (int)((gint64)slots * (w + 1) / workers),
+                               .offset = begin < slots ? store_position_of(&store, begin) : n,
+                               .ranks = ranks, .keys = keys, .ids = ids, .entries = entries };
+    }
+    sort_parallel(sort_gather_worker, tasks, workers);
+
+    if (!text) {
+        // Equal keys keep their incoming order, which must be ascending ids.
+        // Slots are usually in id order, but files saved while deletes
+        // swapped records around, and foreign files, need the ids sorted
+        // first, as the low digits of a (key, id) sort.
+        gboolean ids_ascending = TRUE;
+        for (int i = 1; i < n && ids_ascending; i++) ids_ascending = ids[i - 1] < ids[i];
+
+        for (int pass = ids_ascending ? SORT_RADIX_PASSES : 0; pass < 2 * SORT_RADIX_PASSES; pass++) {
+            int shift = pass % SORT_RADIX_PASSES * SORT_RADIX_BITS;
+            for (int w = 0; w < workers; w++) {
+                tasks[w] = (SortTask){ .begin = (int)((gint64)n * w / workers), .end = (int)((gint64)n * (w + 1) / workers),
+                                       .keys = keys, .ids = ids, .keys_out = keys_out, .ids_out = ids_out, .shift = shift,
+                                       .by_id = pass < SORT_RADIX_PASSES };
+            }
+            sort_parallel(sort_count_worker, tasks, workers);
+
+            // A digit every key shares leaves the order as it is
+            gboolean skip = FALSE;
+            int position = 0;
+            for (int digit = 0; digit < SORT_RADIX; digit++) {
+                int start = position;
+                for (int w = 0; w < workers; w++) {
+                    int count = tasks[w].count[digit];
+                    tasks[w].count[digit] = position;
+                    position += count;
+                }
+                if (position - start == n) skip = TRUE;
+            }
+            if (skip) continue;
+
+            sort_parallel(sort_scatter_worker, tasks, workers);
+            guint32 *swap = keys; keys = keys_out; keys_out = swap;
+            swap = ids; ids = ids_out; ids_out = swap;
+        }
+        memcpy(order->data, ids, (gsize)n * sizeof(int));
+    } else {
+        for (int w = 0; w < workers; w++) {
+            tasks[w] = (SortTask){ .begin = (int)((gint64)n * w / workers), .end = (int)((gint64)n * (w + 1) / workers),
+                                   .entries = entries };
+        }
+        sort_parallel(sort_chunk_worker, tasks, workers);
+
+        // Merge neighbouring sorted chunks pairwise until one run is left
+        for (int width = 1; width < workers; width *= 2) {
+            int pairs = 0;
+            for (int w = 0; w < workers; w += 2 * width) {
+                tasks[pairs++] = (SortTask){ .begin = (int)((gint64)n * w / workers),
+                                             .mid = (int)((gint64)n * MIN(w + width, workers) / workers),
+                                             .end = (int)((gint64)n * MIN(w + 2 * width, workers) / workers),
+                                             .entries = entries, .merged = merged };
+            }
+            sort_parallel(sort_merge_worker, tasks, pairs);
+            SortEntry *swap = entries; entries = merged; merged = swap;
+        }
+
+        for (int w = 0; w < workers; w++) {
+            tasks[w] = (SortTask){ .begin = (int)((gint64)n * w / workers), .end = (int)((gint64)n * (w + 1) / workers),
+                                   .ids = (guint32 *)order->data, .entries = entries };
+        }
+        sort_parallel(sort_release_worker, tasks, workers);
+    }
+
+    g_free(tasks);
+    g_free(ranks);
+    g_free(keys);
+    g_free(ids);
+    g_free(keys_out);
+    g_free(ids_out);
+    g_free(entries);
+    g_free(merged);
+    return order;
+}
+
+// First index in ids whose record does not sort before probe, ids being in
+// ascending order under key (-1 for id order), or descending if asked. An
+// entry with probe's own id is taken to hold probe when self is set, which
+// finds a row whose record has since been edited or deleted.
+guint sort_lower_bound(GArray *ids, int key, gboolean descending, const Student *probe, gboolean self) {
+    guint lo = 0, hi = ids->len;
+    while (lo < hi) {
+        guint mid = lo + (hi - lo) / 2;
+        int id = g_array_index(ids, int, mid);
+        const Student *row = self && id == probe->id ? probe : store_lookup(&store, id);
+        int c = key < 0 ? (row->id > probe->id) - (row->id < probe->id) : sort_compare(key, row, probe);
+        if (descending ? c > 0 : c < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Called by the store after the record in slot was inserted or replaced.
+void sort_on_insert(int slot) {
+    const Student *student = &store.records[slot];
+    for (int key = 0; key < SORT_KEYS; key++) {
+        GArray *order = sort_orders[key];
+        if (!order) continue;
+        guint position = sort_lower_bound(order, key, FALSE, student, FALSE);
+        g_array_insert_val(order, position, student->id);
+    }
+}
+
+// Called by the store before the record in slot is replaced or deleted.
+void sort_on_remove(int slot) {
+    const Student *student = &store.records[slot];
+    for (int key = 0; key < SORT_KEYS; key++) {
+        GArray *order = sort_orders[key];
+        if (!order) continue;
+        guint position = sort_lower_bound(order, key, FALSE, student, TRUE);
+        if (position < order->len && g_array_index(order, int, position) == student->id) {
+            g_array_remove_index(order, position);
+        }
+    }
+}
+
+// Bulk inserts drop the permutations rather than update them a record at a
+// time, and rebuild only the one the table shows.
+void sort_drop_orders() {
+    for (int key = 0; key < SORT_KEYS; key++) {
+        if (sort_orders[key]) g_array_unref(sort_orders[key]);
+        sort_orders[key] = NULL;
+    }
+    if (core_hooks.sort_changed) core_hooks.sort_changed();
+}
+
+void sort_restore_active() {
+    if (sort_active < 0) return;
+    sort_orders[sort_active] = sort_build(sort_active);
+    if (core_hooks.sort_changed) core_hooks.sort_changed();
+}
+
+// Put the ascending ids in rows into key's order by picking them out of its
+// built permutation in one pass. Never compares records, so search workers
+// can call it without reading the dictionaries.
+void sort_rows(GArray *rows, int key, gboolean descending) {
+    if (key < 0) return;
+    GArray *order = sort_orders[key];
+    guint64 *marked = g_new0(guint64, store.next_id / 64 + 1);
+    for (guint i = 0; i < rows->len; i++) {
+        int id = g_array_index(rows, int, i);
+        marked[id / 64] |= G_GUINT64_CONSTANT(1) << (id % 64);
+    }
+    guint kept = 0;
+    for (guint i = 0; i < order->len; i++) {
+        int id = g_array_index(order, int, descending ? order->len - 1 - i : i);
+        if ((marked[id / 64] >> (id % 64)) & 1) g_array_index(rows, int, kept++) = id;
+    }
+    g_free(marked);
+}
@@ -0,0 +1,165 @@
+#include "internal.h"
+
+// ================== STATISTICS ==================
+
+// Running GPA aggregates for the stat cards, kept current by the store on
+// every insert, edit and delete so refreshing the cards never scans the
+// records. Sums are Kahan-compensated doubles, so the average does not drift
+// as millions of edits add and subtract values. GPAs are also counted in
+// 0.01-wide buckets, which gives the exact min and max of spin-button
+// entered values even after the current extreme is deleted.
+
+GpaStats gpa_stats;
+
+static void kahan_add(double *sum, double *c, double value) {
+    double y = value - *c;
+    double t = *sum + y;
+    *c = (t - *sum) - y;
+    *sum = t;
+}
+
+static int gpa_bucket(float gpa) {
+    int b = (int)(gpa * 100.0f + 0.5f);
+    return CLAMP(b, 0, GPA_BUCKETS - 1);
+}
+
+static void stats_apply(float gpa, int sign) {
+    kahan_add(&gpa_stats.sum, &gpa_stats.sum_c, sign * (double)gpa);
+    kahan_add(&gpa_stats.sum_sq, &gpa_stats.sum_sq_c, sign * (double)gpa * gpa);
+    gpa_stats.count += sign;
+    gpa_stats.buckets[gpa_bucket(gpa)] += sign;
+    gpa_stats.generation++;
+}
+
+void stats_on_insert(int slot) {
+    if (gpa_stats.built) stats_apply(store.records[slot].gpa, 1);
+}
+
+void stats_on_remove(int slot) {
+    if (gpa_stats.built) stats_apply(store.records[slot].gpa, -1);
+}
+
+void stats_rebuild() {
+    guint64 generation = gpa_stats.generation + 1;
+    memset(&gpa_stats, 0, sizeof(gpa_stats));
+    gpa_stats.generation = generation;
+    gpa_stats.built = TRUE;
+    int start, end;
+    for (int from = 0; store_next_live_run(&store, from, &start, &end); from = end) {
+        for (int i = start; i < end; i++) stats_apply(columns.gpa[i], 1);
+    }
+}
+
+double stats_mean() {
+    return gpa_stats.count > 0 ? gpa_stats.sum / gpa_stats.count : 0.0;
+}
+
+double stats_stddev() {
+    if (gpa_stats.count < 2) return 0.0;
+    double mean = stats_mean();
+    double var = gpa_stats.sum_sq / gpa_stats.count - mean * mean;
+    return var > 0 ? sqrt(var) : 0.0;
+}
+
+// Lowest and highest GPA, to bucket precision.
+double stats_min() {
+    for (int b = 0; b < GPA_BUCKETS; b++) {
+        if (gpa_stats.buckets[b] > 0) return b / 100.0;
+    }
+    return 0.0;
+}
+
+double stats_max() {
+    for (int b = GPA_BUCKETS - 1; b >= 0; b--) {
+        if (gpa_stats.buckets[b] > 0) return b / 100.0;
+    }
+    return 0.0;
+}
+
+// Value at fraction p of the samples counted in hist, as a bucket number.
+int histogram_percentile(const int *hist, int buckets, int total, double p) {
+    if (total <= 0) return 0;
+    int rank = MAX(1, (int)ceil(p * total));
+    int seen = 0;
+    for (int b = 0; b < buckets; b++) {
+        seen += hist[b];
+        if (seen >= rank) return b;
+    }
+    return buckets - 1;
+}
+
+double stats_percentile(double p) {
+    return histogram_percentile(gpa_stats.buckets, GPA_BUCKETS, gpa_stats.count, p) / 100.0;
+}
+
+// ================== ANALYTICS ==================
+
+// Group-by aggregates (count, mean, GPA histogram) over branch, program and
+// gender, and per-subject mark distributions. These need a pass over every
+// live record, so they are recomputed after edits settle rather than on
+// every change, and only while the analytics panel is open. The pass is a
+// kernel of simple loops over the shadow columns (see COLUMNS), run on each
+// live run of slots.
+
+Analytics analytics;
+
+static void analytics_aggregate(int start, int end) {
+    const float *gpa = columns.gpa;
+    for (int f = 0; f < DICT_GROUP_FIELDS; f++) {
+        GroupAggregate *groups = analytics.groups[f];
+        const guint16 *code = columns.code[f];
+        for (int i = start; i < end; i++) {
+            GroupAggregate *g = &groups[MIN(code[i], ANALYTICS_MAX_GROUPS)];
+            g->count++;
+            g->sum += gpa[i];
+            g->hist[gpa_bucket(gpa[i])]++;
+        }
+    }
+
+    for (int j = 0; j < 6; j++) {
+        MarkDistribution *dist = &analytics.marks[j];
+        const float *marks = columns.marks[j];
+        double sum = 0;
+        for (int i = start; i < end; i++) sum += marks[i];
+        for (int i = start; i < end; i++) {
+            int b = (int)(marks[i] + 0.5f);
+            dist->hist[CLAMP(b, 0, MARK_BUCKETS - 1)]++;
+        }
+        dist->count += end - start;
+        dist->sum += sum;
+    }
+}
+
+void analytics_compute() {
+    memset(analytics.groups, 0, sizeof(analytics.groups));
+    memset(analytics.marks, 0, sizeof(analytics.marks));
+
+    int start, end;
+    for (int from = 0; store_next_live_run(&store, from, &start, &end); from = end) {
+        analytics_aggregate(start, end);
+    }
+
+    // Name the groups and drop values no live student has any more. The
+    // slot after the last code of its own collects every code past it.
+    for (int f = 0; f < DICT_GROUP_FIELDS; f++) {
+        int n = 0;
+        for (int code = 0; code <= ANALYTICS_MAX_GROUPS; code++) {
+            GroupAggregate *g = &analytics.groups[f][code];
+            if (g->count == 0) continue;
+            g_strlcpy(g->name, code == ANALYTICS_MAX_GROUPS ? "Other" : dict_name(f, code),
+                      sizeof(g->name));
+            if (n != code) analytics.groups[f][n] = *g;
+            n++;
+        }
+        analytics.group_count[f] = n;
+    }
+    analytics.generation = gpa_stats.generation;
+}
+
+double group_mean(const GroupAggregate *g) {
+    return g->count > 0 ? g->sum / g->count : 0.0;
+}
+
+double group_percentile(const GroupAggregate *g, double p) {
+    return histogram_percentile(g->hist, GPA_BUCKETS, g->count, p) / 100.0;
+}
@@ -0,0 +1,595 @@
+#include "internal.h"
+
+// ================== RECORD STORE ==================
+
+// Growable record store. All students live in one contiguous slab that is
+// grown geometrically, so there is no per-record allocation and scans stay
+// cache friendly no matter how many students are loaded.
+//
+// The slab may instead be a private mapping of students.dat. Records are then
+// read in place and pages fault in only as they are touched; edits land in
+// copy-on-write pages and the first insert past the mapped count moves the
+// slab onto the heap.
+//
+// Every record carries a stable id handed out from next_id and never reused,
+// which is what the UI, the journal and the indexes refer to. slot_of_id maps
+// an id to its current position.
+//
+// A delete only sets the record's bit in the dead bitset, so it is O(1) and
+// the remaining records keep their order. Slots below count are either live
+// or tombstones; once tombstones pass a quarter of the slots an idle-time
+// pass slides live records down over them a chunk at a time. Positions in
+// the live order are mapped to slots through a per-block rank directory.
+
+StudentStore store = { NULL, 0, 0, NULL, NULL, 0, 1, NULL, 0, NULL, 0, FALSE, -1, 0, 0 };
+
+// Search workers read the store and everything derived from it under
+// store_lock. The main thread, the only writer, holds it exclusively around
+// each insert, edit, delete and compaction step. store_writes counts the
+// changes that can alter search results, so a result computed before one
+// is known to be stale.
+GRWLock store_lock;
+guint64 store_writes = 0;
+
+CoreHooks core_hooks;  // Filled in by the window, empty for the command line
+
+static void store_grow_dead(StudentStore *s);
+
+// Move a mapped slab onto the heap with room for min_capacity records.
+static gboolean store_detach_mapping(StudentStore *s, int min_capacity) {
+    int capacity = MAX(MAX(min_capacity, s->count), STORE_INITIAL_CAPACITY);
+    Student *records = g_try_malloc_n(capacity, sizeof(Student));
+    if (!records) return FALSE;
+
+    memcpy(records, s->records, (gsize)s->count * sizeof(Student));
+    g_mapped_file_unref(s->mapping);
+    s->mapping = NULL;
+    s->records = records;
+    s->capacity = capacity;
+    store_grow_dead(s);
+    return TRUE;
+}
+
+// Make room for at least min_capacity records. Returns FALSE on overflow or OOM.
+gboolean store_reserve(StudentStore *s, int min_capacity) {
+    if (min_capacity <= s->capacity) return TRUE;
+    if (s->mapping && !store_detach_mapping(s, min_capacity)) return FALSE;
+    if (min_capacity <= s->capacity) return TRUE;
+
+    gsize new_capacity = s->capacity > 0 ? (gsize)s->capacity : STORE_INITIAL_CAPACITY;
+    while (new_capacity < (gsize)min_capacity) {
+        new_capacity *= 2;
+    }
+    if (new_capacity > G_MAXINT) new_capacity = G_MAXINT;
+
+    Student *records = g_try_realloc_n(s->records, new_capacity, sizeof(Student));
+    if (!records) return FALSE;
+
+    s->records = records;
+    s->capacity = (int)new_capacity;
+    store_grow_dead(s);
+    return TRUE;
+}
+
+static gboolean store_map_id(StudentStore *s, int id, int slot) {
+    if (id >= s->id_capacity) {
+        gsize new_capacity = s->id_capacity > 0 ? (gsize)s->id_capacity : STORE_INITIAL_CAPACITY;
+        while (new_capacity <= (gsize)id) {
+            new_capacity *= 2;
+        }
+        if (new_capacity > G_MAXINT) new_capacity = G_MAXINT;
+
+        int *slots = g_try_realloc_n(s->slot_of_id, new_capacity, sizeof(int));
+        if (!slots) return FALSE;
+        memset(slots + s->id_capacity, 0xFF, (new_capacity - s->id_capacity) * sizeof(int));
+        s->slot_of_id = slots;
+        s->id_capacity = (int)new_capacity;
+    }
+    s->slot_of_id[id] = slot;
+    return TRUE;
+}
+
+// Keep the tombstone bitset as large as the slab once it exists.
+static void store_grow_dead(StudentStore *s) {
+    if (!s->dead) return;
+    gsize old_words = ((gsize)s->count + 63) / 64;
+    gsize words = ((gsize)s->capacity + 63) / 64;
+    s->dead = g_renew(guint64, s->dead, MAX(words, 1));
+    memset(s->dead + old_words, 0, (MAX(words, 1) - old_words) * sizeof(guint64));
+}
+
+static inline gboolean store_slot_dead(const StudentStore *s, int slot) {
+    return s->dead && (s->dead[slot / 64] >> (slot % 64)) & 1;
+}
+
+// Number of live students.
+int store_count(const StudentStore *s) {
+    return s->count - s->dead_count;
+}
+
+// Upper bound for iterating slots; tombstoned ones must be skipped.
+int store_slots(const StudentStore *s) {
+    return s->count;
+}
+
+gboolean store_is_live(const StudentStore *s, int slot) {
+    return slot >= 0 && slot < s->count && !store_slot_dead(s, slot);
+}
+
+// Record in a slot, or NULL if the slot is out of range or a tombstone.
+Student *store_get(StudentStore *s, int index) {
+    if (!store_is_live(s, index)) return NULL;
+    return &s->records[index];
+}
+
+guint64 store_live_word(const StudentStore *s, int word) {
+    guint64 live = ~s->dead[word];
+    if ((word + 1) * 64 > s->count) live &= (G_GUINT64_CONSTANT(1) << (s->count % 64)) - 1;
+    return live;
+}
+
+static void store_rank_rebuild(StudentStore *s) {
+    int words = (s->count + 63) / 64;
+    int blocks = words / STORE_RANK_WORDS + 1;
+    s->rank = g_renew(int, s->rank, blocks);
+    s->rank_len = blocks;
+
+    int live = 0;
+    for (int w = 0; w < blocks * STORE_RANK_WORDS; w++) {
+        if (w % STORE_RANK_WORDS == 0) s->rank[w / STORE_RANK_WORDS] = live;
+        if (w < words) live += __builtin_popcountll(store_live_word(s, w));
+    }
+    s->rank_dirty = FALSE;
+}
+
+// Position of slot among the live records, i.e. how many live slots precede
+// it. Also valid for a slot that was just tombstoned.
+int store_position_of(StudentStore *s, int slot) {
+    if (s->dead_count == 0) return slot;
+    if (s->rank_dirty || !s->rank) store_rank_rebuild(s);
+
+    int word = slot / 64;
+    int position = s->rank[word / STORE_RANK_WORDS];
+    for (int w = word - word % STORE_RANK_WORDS; w < word; w++) {
+        position += __builtin_popcountll(store_live_word(s, w));
+    }
+    guint64 below = (G_GUINT64_CONSTANT(1) << (slot % 64)) - 1;
+    return position + __builtin_popcountll(store_live_word(s, word) & below);
+}
+
+// Slot of the live record at position, or -1.
+int store_slot_at(StudentStore *s, int position) {
+    if (position < 0 || position >= store_count(s)) return -1;
+    if (s->dead_count == 0) return position;
+    if (s->rank_dirty || !s->rank) store_rank_rebuild(s);
+
+    // Last block starting at or before position
+    int lo = 0, hi = (s->count + 63) / 64 / STORE_RANK_WORDS;
+    while (lo < hi) {
+        int mid = lo + (hi - lo + 1) / 2;
+        if (s->rank[mid] <= position) lo = mid;
+        else hi = mid - 1;
+    }
+
+    int remaining = position - s->rank[lo];
+    for (int w = lo * STORE_RANK_WORDS;; w++) {
+        guint64 live = store_live_word(s, w);
+        int n = __builtin_popcountll(live);
+        if (remaining < n) {
+            while (remaining-- > 0) live &= live - 1;
+            return w * 64 + __builtin_ctzll(live);
+        }
+        remaining -= n;
+    }
+}
+
+// Current slot of the record with this id, or -1.
+int store_slot_of(const StudentStore *s, int id) {
+    if (id <= 0 || id >= s->id_capacity) return -1;
+    return s->slot_of_id[id];
+}
+
+Student *store_lookup(StudentStore *s, int id) {
+    return store_get(s, store_slot_of(s, id));
+}
+
+// Rebuild the id map after records were loaded in bulk. Ids at or above
+// first_free_id are never reissued. Files written before ids were stable
+// numbered students by position, so ids that are missing or repeated cause
+// every record to be renumbered; returns TRUE if that happened.
+gboolean store_index_ids(StudentStore *s, int first_free_id) {
+    gboolean renumber = FALSE;
+    int max_id = 0;
+
+    memset(s->slot_of_id, 0xFF, (gsize)s->id_capacity * sizeof(int));
+    for (int i = 0; i < s->count && !renumber; i++) {
+        if (store_slot_dead(s, i)) continue;
+        int id = s->records[i].id;
+        renumber = id <= 0 || id == G_MAXINT || store_slot_of(s, id) >= 0 || !store_map_id(s, id, i);
+        max_id = MAX(max_id, id);
+    }
+
+    if (renumber) {
+        memset(s->slot_of_id, 0xFF, (gsize)s->id_capacity * sizeof(int));
+        int id = 0;
+        for (int i = 0; i < s->count; i++) {
+            if (store_slot_dead(s, i)) continue;
+            s->records[i].id = ++id;
+            store_map_id(s, id, i);
+        }
+        max_id = id;
+    }
+
+    s->next_id = MAX(MAX(first_free_id, max_id + 1), 1);
+    return renumber;
+}
+
+// Called around every change to the main store. A change to the records
+// (compaction only moves them) first lets the front end cancel any search
+// running on a worker, so waiting for its read lock stays short.
+static void store_write_begin(StudentStore *s, gboolean changes_records) {
+    if (s != &store) return;
+    if (changes_records && core_hooks.store_changing) core_hooks.store_changing();
+    g_rw_lock_writer_lock(&store_lock);
+    if (changes_records) store_writes++;
+}
+
+static void store_write_end(StudentStore *s) {
+    if (s == &store) g_rw_lock_writer_unlock(&store_lock);
+}
+
+// Append a copy of student. A new id is assigned unless the record already
+// carries one that was never issued (as replayed journal entries do).
+// Returns the slot, or -1 if the store is full or another student already
+// has the same reg number.
+static int store_insert_locked(StudentStore *s, const Student *student) {
+    if (s == &store && store_find_reg(student->reg_num) >= 0) return -1;
+    if (s->count == G_MAXINT || !store_reserve(s, s->count + 1)) return -1;
+
+    int id = student->id;
+    if (id < s->next_id || id == G_MAXINT) id = s->next_id;
+    if (id == G_MAXINT || !store_map_id(s, id, s->count)) return -1;
+
+    s->records[s->count] = *student;
+    s->records[s->count].id = id;
+    s->next_id = MAX(s->next_id, id + 1);
+
+    int slot = s->count++;
+    // Appends only touch the directory's trailing entries
+    int block = slot / 64 / STORE_RANK_WORDS;
+    if (block >= s->rank_len) s->rank_dirty = TRUE;
+    for (int b = block + 1; !s->rank_dirty && b < s->rank_len; b++) {
+        s->rank[b]++;
+    }
+    if (s == &store) {
+        reg_index_on_insert(slot);
+        search_index_on_insert(slot);
+        columns_on_store(slot);
+        stats_on_insert(slot);
+        sort_on_insert(slot);
+    }
+    return slot;
+}
+
+int store_insert(StudentStore *s, const Student *student) {
+    store_write_begin(s, TRUE);
+    int result = store_insert_locked(s, student);
+    store_write_end(s);
+    return result;
+}
+
+// Append n students under one write lock, for bulk imports. Returns how
+// many went in; a record is skipped if its reg number is taken. Indexes
+// that keep a sorted array are rebuilt afterwards rather than shifted once
+// per record.
+int store_insert_batch(StudentStore *s, const Student *students, int n) {
+    store_write_begin(s, TRUE);
+    if (s == &store) {
+        sort_drop_orders();
+        search_index_invalidate();
+    }
+    store_reserve(s, s->count + n);
+    int added = 0;
+    for (int i = 0; i < n; i++) {
+        if (store_insert_locked(s, &students[i]) >= 0) added++;
+    }
+    if (s == &store) sort_restore_active();
+    store_write_end(s);
+    return added;
+}
+
+// Replace the record with this id, keeping the id. Returns FALSE if there is
+// no such record or the new reg number belongs to another student.
+static gboolean store_update_locked(StudentStore *s, int id, const Student *student) {
+    int index = store_slot_of(s, id);
+    Student *slot = store_get(s, index);
+    if (!slot) return FALSE;
+
+    if (s == &store) {
+        int owner = store_find_reg(student->reg_num);
+        if (owner >= 0 && owner != id) return FALSE;
+        // Marks and other fields leave the search index as it is
+        gboolean searchable = strncmp(slot->name, student->name, sizeof(slot->name)) != 0 ||
+                              strncmp(slot->reg_num, student->reg_num, sizeof(slot->reg_num)) != 0;
+        if (owner != id) reg_index_on_remove(index);
+        if (searchable) search_index_on_remove(index);
+        stats_on_remove(index);
+        sort_on_remove(index);
+        *slot = *student;
+        slot->id = id;
+        if (owner != id) reg_index_on_insert(index);
+        if (searchable) search_index_on_insert(index);
+        columns_on_store(index);
+        stats_on_insert(index);
+        sort_on_insert(index);
+        return TRUE;
+    }
+    *slot = *student;
+    slot->id = id;
+    return TRUE;
+}
+
+gboolean store_update(StudentStore *s, int id, const Student *student) {
+    store_write_begin(s, TRUE);
+    gboolean result = store_update_locked(s, id, student);
+    store_write_end(s);
+    return result;
+}
+
+static gboolean store_compact_idle(gpointer data);
+
+// Delete the record with this id in O(1) by tombstoning its slot. Returns
+// the slot, or -1 if there is no such record.
+static int store_remove_locked(StudentStore *s, int id) {
+    int index = store_slot_of(s, id);
+    if (index < 0) return -1;
+    if (s == &store) {
+        reg_index_on_remove(index);
+        search_index_on_remove(index);
+        stats_on_remove(index);
+        sort_on_remove(index);
+    }
+
+    if (!s->dead) {
+        s->dead = g_new0(guint64, MAX(((gsize)s->capacity + 63) / 64, 1));
+    }
+    s->dead[index / 64] |= G_GUINT64_CONSTANT(1) << (index % 64);
+    s->dead_count++;
+    for (int b = index / 64 / STORE_RANK_WORDS + 1; !s->rank_dirty && b < s->rank_len; b++) {
+        s->rank[b]--;
+    }
+    s->slot_of_id[id] = -1;
+
+    if (s->dead_count >= STORE_COMPACT_MIN_DEAD && s->dead_count * 4 >= s->count &&
+        !s->compact_source) {
+        s->compact_source = g_idle_add(store_compact_idle, s);
+    }
+    return index;
+}
+
+int store_remove(StudentStore *s, int id) {
+    store_write_begin(s, TRUE);
+    int result = store_remove_locked(s, id);
+    store_write_end(s);
+    return result;
+}
+
+// Run one step of a compaction pass: slide up to budget slots' worth of live
+// records down over tombstones, preserving their order. Records inserted or
+// deleted between steps are handled as the pass reaches them. Returns TRUE
+// when the pass has finished.
+static gboolean store_compact_step_locked(StudentStore *s, int budget) {
+    if (s->compact_read < 0) {
+        if (s->dead_count == 0) return TRUE;
+        // Start at the first tombstone; everything before it stays put
+        int w = 0;
+        while (s->dead[w] == 0) w++;
+        s->compact_read = s->compact_write = w * 64 + __builtin_ctzll(s->dead[w]);
+    }
+    if (s->mapping && !store_detach_mapping(s, s->count)) return FALSE;
+
+    int end = s->compact_read + MIN(budget, s->count - s->compact_read);
+    int write = s->compact_write;
+    for (int read = s->compact_read; read < end; read++) {
+        if (store_slot_dead(s, read)) continue;
+        // write is always a tombstone or already-moved garbage slot
+        s->records[write] = s->records[read];
+        s->slot_of_id[s->records[write].id] = write;
+        if (s == &store) columns_on_move(read, write);
+        s->dead[write / 64] &= ~(G_GUINT64_CONSTANT(1) << (write % 64));
+        s->dead[read / 64] |= G_GUINT64_CONSTANT(1) << (read % 64);
+        write++;
+    }
+    s->compact_read = end;
+    s->compact_write = write;
+    s->rank_dirty = TRUE;
+
+    if (end < s->count) return FALSE;
+
+    // Everything from write on is now garbage
+    for (int slot = write; slot < s->count; slot++) {
+        s->dead[slot / 64] &= ~(G_GUINT64_CONSTANT(1) << (slot % 64));
+    }
+    s->dead_count -= s->count - write;
+    s->count = write;
+    s->compact_read = -1;
+    return TRUE;
+}
+
+gboolean store_compact_step(StudentStore *s, int budget) {
+    store_write_begin(s, FALSE);
+    gboolean result = store_compact_step_locked(s, budget);
+    store_write_end(s);
+    return result;
+}
+
+// Reclaim every tombstone now.
+void store_compact(StudentStore *s) {
+    while (s->dead_count > 0 || s->compact_read >= 0) {
+        if (!store_compact_step(s, G_MAXINT)) break;
+    }
+}
+
+static gboolean store_compact_idle(gpointer data) {
+    StudentStore *s = data;
+    if (!store_compact_step(s, STORE_COMPACT_CHUNK)) return G_SOURCE_CONTINUE;
+    s->compact_source = 0;
+    return G_SOURCE_REMOVE;
+}
+
+// Copy of the live records in order, for writing a snapshot while the store
+// keeps changing.
+Student *store_copy_live(StudentStore *s, int *count) {
+    *count = store_count(s);
+    if (s->dead_count == 0) return g_memdup2(s->records, (gsize)s->count * sizeof(Student));
+
+    Student *copy = g_new(Student, MAX(*count, 1));
+    int n = 0;
+    for (int i = 0; i < s->count; i++) {
+        if (!store_slot_dead(s, i)) copy[n++] = s->records[i];
+    }
+    return copy;
+}
+
+void store_foreach(StudentStore *s, StoreForeachFunc func, gpointer user_data) {
+    for (int i = 0; i < s->count; i++) {
+        if (store_slot_dead(s, i)) continue;
+        func(&s->records[i], i, user_data);
+    }
+}
+
+void store_clear(StudentStore *s) {
+    if (s->mapping) {
+        g_mapped_file_unref(s->mapping);
+        s->mapping = NULL;
+        s->records = NULL;
+    }
+    g_free(s->records);
+    s->records = NULL;
+    s->count = 0;
+    s->capacity = 0;
+    g_free(s->slot_of_id);
+    s->slot_of_id = NULL;
+    s->id_capacity = 0;
+    s->next_id = 1;
+    g_free(s->dead);
+    s->dead = NULL;
+    s->dead_count = 0;
+    g_free(s->rank);
+    s->rank = NULL;
+    s->rank_len = 0;
+    s->compact_read = -1;
+    if (s->compact_source) g_source_remove(s->compact_source);
+    s->compact_source = 0;
+
+    // The indexes refer to records by id and would outlive them
+    if (s == &store) {
+        reg_index_reset();
+        search_index_invalidate();
+    }
+}
+
+// Serve count records read in place from mapping, starting at offset.
+void store_attach_mapping(StudentStore *s, GMappedFile *mapping, gsize offset, int count) {
+    store_clear(s);
+    s->mapping = g_mapped_file_ref(mapping);
+    s->records = (Student *)(g_mapped_file_get_contents(mapping) + offset);
+    s->count = count;
+    s->capacity = count;
+}
+
+// Drop any file mapping. Windows cannot replace a file that is still mapped,
+// so this runs before students.dat is swapped for a new snapshot there.
+void store_release_mapping(StudentStore *s) {
+    if (s->mapping) store_detach_mapping(s, s->count);
+}
+// ================== COLUMNS ==================
+
+// Struct-of-arrays shadow of the numeric and categorical fields, indexed by
+// slot like store.records. Scans over GPA, age, marks or the branch, program
+// and gender of every student read these dense arrays instead of dragging
+// whole Student records (mostly names and phone numbers) through the cache.
+// Branch, program and gender are kept as their dictionary codes.
+//
+// Rows are written by the store on insert and edit and moved by compaction;
+// a tombstoned slot keeps its stale row, so scans walk live runs of slots.
+
+StudentColumns columns;
+
+guint16 student_dict_code(const Student *student, DictField field) {
+    switch (field) {
+    case DICT_BRANCH: return student->branch;
+    case DICT_PROGRAM: return student->program;
+    default: return student->gender;
+    }
+}
+
+static void columns_reserve(int min_capacity) {
+    if (min_capacity <= columns.capacity) return;
+    int capacity = MAX(columns.capacity, STORE_INITIAL_CAPACITY);
+    while (capacity < min_capacity) capacity *= 2;
+
+    columns.age = g_renew(int, columns.age, capacity);
+    columns.gpa = g_renew(float, columns.gpa, capacity);
+    for (int j = 0; j < 6; j++) columns.marks[j] = g_renew(float, columns.marks[j], capacity);
+    for (int f = 0; f < DICT_GROUP_FIELDS; f++) columns.code[f] = g_renew(guint16, columns.code[f], capacity);
+    columns.capacity = capacity;
+}
+
+static void columns_write(int slot, const Student *student) {
+    columns.age[slot] = student->age;
+    columns.gpa[slot] = student->gpa;
+    for (int j = 0; j < 6; j++) columns.marks[j][slot] = student->subjects[j].marks;
+    for (int f = 0; f < DICT_GROUP_FIELDS; f++) columns.code[f][slot] = student_dict_code(student, f);
+}
+
+// Called by the store after the record in slot was inserted or replaced.
+void columns_on_store(int slot) {
+    if (!columns.built) return;
+    columns_reserve(slot + 1);
+    columns_write(slot, &store.records[slot]);
+}
+
+// Called by compaction after the record in from moved down to to.
+void columns_on_move(int from, int to) {
+    if (!columns.built) return;
+    columns.age[to] = columns.age[from];
+    columns.gpa[to] = columns.gpa[from];
+    for (int j = 0; j < 6; j++) columns.marks[j][to] = columns.marks[j][from];
+    for (int f = 0; f < DICT_GROUP_FIELDS; f++) columns.code[f][to] = columns.code[f][from];
+}
+
+void columns_rebuild() {
+    columns_reserve(store_slots(&store));
+    for (int i = 0; i < store_slots(&store); i++) columns_write(i, &store.records[i]);
+    columns.built = TRUE;
+}
+
+// Next run [*start, *end) of live slots at or after from. Returns FALSE
+// when there are no more.
+gboolean store_next_live_run(const StudentStore *s, int from, int *start, int *end) {
+    int n = s->count;
+    if (s->dead_count == 0) {
+        *start = from;
+        *end = n;
+        return from < n;
+    }
+
+    // Find the first live slot, then the first dead one after it
+    for (int want_dead = 0; want_dead < 2; want_dead++) {
+        while (from < n) {
+            guint64 word = s->dead[from / 64];
+            if (!want_dead) word = ~word;
+            word &= ~G_GUINT64_CONSTANT(0) << (from % 64);
+            if (word) {
+                from = MIN(from / 64 * 64 + __builtin_ctzll(word), n);
+                break;
+            }
+            from = (from / 64 + 1) * 64;
+        }
+        from = MIN(from, n);
+        if (!want_dead) *start = from;
+    }
+    *end = from;
+    return *start < n;
+}
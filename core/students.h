@@ -0,0 +1,331 @@
+// Student record engine: the record store and its indexes, the on-disk
+// snapshot and journal, queries, sorting, statistics, CSV import and
+// export. Depends on GLib and GIO only, so the window, the command line
+// and the benchmarks all link the same code.
+//
+// Everything here runs on the main thread unless a function says it is
+// safe elsewhere. Workers read the store under store_lock and the
+// dictionaries under dict_lock.
+
+#ifndef STUDENTS_H
+#define STUDENTS_H
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <stdio.h>
+
+#define FILE_NAME "students.dat"
+#define JOURNAL_FILE_NAME "students.journal"
+#define GPA_BUCKETS 1001                // 0.00 to 10.00 in steps of 0.01
+#define MARK_BUCKETS 101                // whole marks 0 to 100
+#define ANALYTICS_MAX_GROUPS 32         // values past these share one more "Other" group
+
+// Branch, program, gender and subject names repeat across nearly every
+// student, so records hold a code into a string dictionary for each (see
+// STRING DICTIONARIES); code 0 is the empty string.
+typedef struct {
+    int id;
+    char name[50];
+    char reg_num[20];
+    guint16 branch;
+    guint16 program;
+    guint16 gender;
+    char phone[15];
+    int age;
+    float gpa;
+    struct {
+        guint16 subject_name;
+        float marks;
+    } subjects[6];
+} Student;
+
+typedef enum {
+    JOURNAL_OP_INSERT = 1,
+    JOURNAL_OP_UPDATE = 2,
+    JOURNAL_OP_DELETE = 3,
+    JOURNAL_OP_DICT = 4     // A new dictionary string, see JournalDictEntry
+} JournalOp;
+
+// ---- Front end hooks ----
+
+// Set by the window to hear about engine events it shows; any may be NULL.
+typedef struct {
+    void (*store_changing)(void);   // A write that changes records is about to take store_lock
+    void (*persist_changed)(void);  // persist_pending or persist_failed changed
+    void (*sort_changed)(void);     // sort_orders were dropped or rebuilt in bulk
+} CoreHooks;
+
+extern CoreHooks core_hooks;
+
+// ---- Tracing ----
+
+// Timed spans, recorded only while tracing is on and written out as a
+// Chrome trace that Perfetto and chrome://tracing open. With tracing off a
+// span costs one atomic load and a branch. Span names must be string
+// literals. Safe on any thread.
+typedef enum {
+    TRACE_IO,       // Loading, saving and the writer thread
+    TRACE_MODEL,    // Rebuilding the rows the table shows
+    TRACE_SEARCH,   // Evaluating queries
+    TRACE_UI,       // Binding rows, theming
+    TRACE_FRAME,    // Layout and paint of one frame
+    TRACE_CATEGORIES
+} TraceCategory;
+
+typedef struct {
+    gint64 last_us;   // Latest span
+    gint64 max_us;    // Longest, total and count since the previous take
+    gint64 total_us;
+    int count;
+} TraceSummary;
+
+extern gint trace_on;
+
+#define TRACE_BEGIN(span) gint64 span = G_UNLIKELY(g_atomic_int_get(&trace_on)) ? g_get_monotonic_time() : 0
+#define TRACE_END(span, name, category) \
+    do { if (G_UNLIKELY(span)) trace_record((name), (category), (span), g_get_monotonic_time() - (span)); } while (0)
+
+void trace_set_enabled(gboolean enabled);
+void trace_name_thread(const char *name);
+void trace_record(const char *name, TraceCategory category, gint64 start_us, gint64 duration_us);
+void trace_take_summary(TraceCategory category, TraceSummary *out);
+gboolean trace_write(const char *path);
+void trace_start_from_env();
+void trace_finish();
+
+// ---- String dictionaries ----
+
+typedef enum {
+    DICT_BRANCH,
+    DICT_PROGRAM,
+    DICT_GENDER,
+    DICT_SUBJECT,
+    DICT_FIELDS
+} DictField;
+
+#define DICT_GROUP_FIELDS DICT_SUBJECT  // Branch, program and gender
+#define DICT_FULL G_MAXUINT16           // dict_intern's answer once codes run out
+
+extern GRWLock dict_lock;
+
+void dict_reset(DictField field);
+guint16 dict_intern(DictField field, const char *s);
+guint16 dict_intern_chars(DictField field, const char *chars, gsize size);
+const char *dict_name(DictField field, guint16 code);
+int dict_size(DictField field);
+void dict_push(DictField field, const char *s);
+void dict_load(DictField field, const char *const *strings, int count);
+GPtrArray *dict_copy(DictField field);
+gboolean student_codes_valid(const Student *student);
+
+extern char default_subject_names[6][50];
+// The form's choices, NULL-terminated; sized so importers can count them
+extern const char *branch_choices[8];
+extern const char *program_choices[4];
+extern const char *gender_choices[4];
+
+// ---- Record store ----
+
+typedef struct {
+    Student *records;
+    int count;            // Slots in use, live or dead
+    int capacity;
+    GMappedFile *mapping; // Non-NULL while records point into students.dat
+    int *slot_of_id;      // Id -> slot, -1 for ids not in use
+    int id_capacity;
+    int next_id;
+    guint64 *dead;        // Tombstone bit per slot, NULL until the first delete
+    int dead_count;
+    int *rank;            // Live slots before each block of STORE_RANK_WORDS words
+    int rank_len;
+    gboolean rank_dirty;
+    int compact_read;     // Progress of an incremental compaction pass
+    int compact_write;
+    guint compact_source; // Idle source driving the pass, 0 when idle
+} StudentStore;
+
+typedef void (*StoreForeachFunc)(Student *student, int index, gpointer user_data);
+
+extern StudentStore store;
+extern GRWLock store_lock;
+extern guint64 store_writes;
+
+gboolean store_reserve(StudentStore *s, int min_capacity);
+int store_count(const StudentStore *s);
+int store_slots(const StudentStore *s);
+gboolean store_is_live(const StudentStore *s, int slot);
+Student *store_get(StudentStore *s, int index);
+int store_position_of(StudentStore *s, int slot);
+int store_slot_at(StudentStore *s, int position);
+int store_slot_of(const StudentStore *s, int id);
+Student *store_lookup(StudentStore *s, int id);
+gboolean store_index_ids(StudentStore *s, int first_free_id);
+int store_insert(StudentStore *s, const Student *student);
+int store_insert_batch(StudentStore *s, const Student *students, int n);
+gboolean store_update(StudentStore *s, int id, const Student *student);
+int store_remove(StudentStore *s, int id);
+gboolean store_compact_step(StudentStore *s, int budget);
+void store_compact(StudentStore *s);
+Student *store_copy_live(StudentStore *s, int *count);
+void store_foreach(StudentStore *s, StoreForeachFunc func, gpointer user_data);
+void store_clear(StudentStore *s);
+void store_attach_mapping(StudentStore *s, GMappedFile *mapping, gsize offset, int count);
+void store_release_mapping(StudentStore *s);
+gboolean store_next_live_run(const StudentStore *s, int from, int *start, int *end);
+int store_find_reg(const char *reg);
+
+void reg_index_rebuild();
+void search_index_rebuild();
+void columns_rebuild();
+
+// ---- Snapshot and journal ----
+
+typedef struct {
+    char magic[8];
+    guint32 endian_mark;
+    guint16 version;
+    guint16 header_size;
+    guint32 record_size;
+    guint32 field_count;
+    guint32 block_records;
+    guint32 record_count;
+    guint64 seq;            // Last journal entry folded into this snapshot
+    guint64 records_offset;
+    guint64 crc_offset;
+    guint32 header_crc;
+    guint32 next_id;        // First record id never issued, 0 if unknown
+} FileHeader;
+
+typedef enum {
+    FILE_LAYOUT_EMPTY,
+    FILE_LAYOUT_LEGACY,
+    FILE_LAYOUT_NATIVE,   // Same layout and byte order, can be read in place
+    FILE_LAYOUT_FOREIGN,  // Valid, but records need per-field conversion
+    FILE_LAYOUT_INVALID
+} FileLayout;
+
+extern int persist_pending;
+extern gboolean persist_failed;
+
+guint32 crc32c(guint32 crc, const void *data, gsize len);
+FileLayout file_check(const char *path, FileHeader *header, gint64 *bad_block);
+gboolean journal_verify(const char *path, int *entries);
+void load_data();
+void save_data();
+void journal_append(JournalOp op, int id, const Student *student);
+void journal_append_inserts(const Student *students, int n);
+void journal_compact_async();
+void persist_shutdown();
+
+// ---- Queries ----
+
+typedef struct Query Query;
+
+Query *query_compile(const char *text, char **error);
+void query_free(Query *query);
+gboolean query_matches(const Query *query, const Student *student);
+guint64 *query_run(const Query *query, GCancellable *cancellable);
+GArray *search_students(const char *query, char **error);
+gboolean search_matches(const Student *student, const char *query);
+
+// ---- Sorting ----
+
+// Columns the table can be sorted by
+typedef enum {
+    SORT_NAME,
+    SORT_REG,
+    SORT_BRANCH,
+    SORT_PROGRAM,
+    SORT_GENDER,
+    SORT_PHONE,
+    SORT_AGE,
+    SORT_GPA,
+    SORT_KEYS
+} SortKey;
+
+extern GArray *sort_orders[SORT_KEYS];
+extern int sort_active;
+extern gboolean sort_descending;
+
+int sort_compare(SortKey key, const Student *a, const Student *b);
+GArray *sort_build(SortKey key);
+guint sort_lower_bound(GArray *ids, int key, gboolean descending, const Student *probe, gboolean self);
+void sort_rows(GArray *rows, int key, gboolean descending);
+
+// ---- Statistics ----
+
+typedef struct {
+    double sum, sum_c;         // Kahan sum of GPAs and its compensation
+    double sum_sq, sum_sq_c;   // Same for squared GPAs
+    int count;
+    int buckets[GPA_BUCKETS];
+    guint64 generation;        // Bumped on every change, for derived views
+    gboolean built;
+} GpaStats;
+
+typedef struct {
+    char name[32];
+    int count;
+    double sum;
+    int hist[GPA_BUCKETS];
+} GroupAggregate;
+
+typedef struct {
+    int count;
+    double sum;
+    int hist[MARK_BUCKETS];
+} MarkDistribution;
+
+typedef struct {
+    GroupAggregate groups[DICT_GROUP_FIELDS][ANALYTICS_MAX_GROUPS + 1];
+    int group_count[DICT_GROUP_FIELDS];
+    MarkDistribution marks[6];
+    guint64 generation;                 // gpa_stats.generation when computed
+} Analytics;
+
+extern GpaStats gpa_stats;
+extern Analytics analytics;
+
+void stats_rebuild();
+double stats_mean();
+double stats_stddev();
+double stats_min();
+double stats_max();
+double stats_percentile(double p);
+int histogram_percentile(const int *hist, int buckets, int total, double p);
+void analytics_compute();
+double group_mean(const GroupAggregate *g);
+double group_percentile(const GroupAggregate *g, double p);
+
+// ---- CSV import ----
+
+typedef struct ImportBatch ImportBatch;
+
+ImportBatch *import_parse(const char *path, char **error);
+int import_commit(ImportBatch *batch);
+char *import_summary(const ImportBatch *batch, int added);
+void import_batch_free(ImportBatch *batch);
+int import_file(const char *path);
+
+// ---- Export ----
+
+typedef enum {
+    EXPORT_CSV,
+    EXPORT_JSON,
+    EXPORT_MARKSHEET
+} ExportFormat;
+
+typedef struct {
+    char *path;
+    ExportFormat format;
+    int exported;
+    gint progress;  // Per mille, read by the main thread
+} ExportJob;
+
+ExportFormat export_format_for_path(const char *path);
+gboolean export_students(ExportJob *job, GCancellable *cancellable, char **error);
+gboolean export_ids(FILE *fp, GArray *ids, ExportFormat format);
+ExportJob *export_job_new(const char *path, ExportFormat format);
+void export_job_free(ExportJob *job);
+
+#endif
@@ -0,0 +1,133 @@
+#include "internal.h"
+
+// ================== TRACING ==================
+
+// Spans go into a ring of the last TRACE_CAPACITY events, allocated the
+// first time tracing is turned on, so a long session keeps its most recent
+// history at a fixed cost. Recording takes a mutex, which only tracing pays
+// for. Each category also keeps a running summary for the window's overlay.
+//
+// Setting STUDENTS_TRACE=FILE turns tracing on at startup and writes FILE
+// at exit, in the Chrome trace event format. Frames are drawn on a track of
+// their own, since they do not nest with the main thread's spans.
+
+#define TRACE_CAPACITY (1 << 18)
+#define TRACE_MAX_THREADS 64
+#define TRACE_FRAME_TID 0
+
+typedef struct {
+    const char *name;
+    gint64 start_us;
+    gint64 duration_us;
+    guint16 category;
+    guint16 tid;
+} TraceEvent;
+
+gint trace_on = 0;
+
+static GMutex trace_mutex;
+static TraceEvent *trace_events;
+static guint trace_next;          // Events ever recorded; the ring holds the latest
+static TraceSummary trace_summaries[TRACE_CATEGORIES];
+static const char *trace_thread_names[TRACE_MAX_THREADS];
+static int trace_threads;
+static _Thread_local int trace_tid;  // 1 based, 0 until the thread first records
+
+static const char *const trace_category_names[TRACE_CATEGORIES] = {
+    "io", "model", "search", "ui", "frame"
+};
+
+// This thread's id in the trace. Takes trace_mutex.
+static int trace_thread_id() {
+    if (trace_tid == 0) {
+        g_mutex_lock(&trace_mutex);
+        if (trace_threads < TRACE_MAX_THREADS - 1) trace_threads++;
+        trace_tid = trace_threads;
+        g_mutex_unlock(&trace_mutex);
+    }
+    return trace_tid;
+}
+
+void trace_set_enabled(gboolean enabled) {
+    if (enabled && !trace_events) {
+        trace_events = g_new(TraceEvent, TRACE_CAPACITY);
+        // Whoever turns tracing on first is the main thread
+        trace_name_thread("main");
+    }
+    g_atomic_int_set(&trace_on, enabled);
+}
+
+// Name the calling thread's track in written traces.
+void trace_name_thread(const char *name) {
+    int tid = trace_thread_id();
+    g_mutex_lock(&trace_mutex);
+    trace_thread_names[tid] = name;
+    g_mutex_unlock(&trace_mutex);
+}
+
+void trace_record(const char *name, TraceCategory category, gint64 start_us, gint64 duration_us) {
+    int tid = category == TRACE_FRAME ? TRACE_FRAME_TID : trace_thread_id();
+    g_mutex_lock(&trace_mutex);
+    if (trace_events) {
+        TraceEvent *e = &trace_events[trace_next++ % TRACE_CAPACITY];
+        e->name = name;
+        e->start_us = start_us;
+        e->duration_us = duration_us;
+        e->category = category;
+        e->tid = tid;
+    }
+    TraceSummary *summary = &trace_summaries[category];
+    summary->last_us = duration_us;
+    summary->max_us = MAX(summary->max_us, duration_us);
+    summary->total_us += duration_us;
+    summary->count++;
+    g_mutex_unlock(&trace_mutex);
+}
+
+// Copy a category's summary and start its next window.
+void trace_take_summary(TraceCategory category, TraceSummary *out) {
+    g_mutex_lock(&trace_mutex);
+    TraceSummary *summary = &trace_summaries[category];
+    *out = *summary;
+    summary->max_us = 0;
+    summary->total_us = 0;
+    summary->count = 0;
+    g_mutex_unlock(&trace_mutex);
+}
+
+// Write the events in the ring to path as a Chrome trace, oldest first.
+gboolean trace_write(const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) return FALSE;
+
+    g_mutex_lock(&trace_mutex);
+    fputs("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n", fp);
+    fprintf(fp, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"students\"}},\n"
+                "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"frames\"}}",
+            TRACE_FRAME_TID);
+    for (int tid = 1; tid <= trace_threads; tid++) {
+        fprintf(fp, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+                tid, trace_thread_names[tid] ? trace_thread_names[tid] : "worker");
+    }
+    guint first = trace_next > TRACE_CAPACITY ? trace_next - TRACE_CAPACITY : 0;
+    for (guint i = first; trace_events && i != trace_next; i++) {
+        const TraceEvent *e = &trace_events[i % TRACE_CAPACITY];
+        fprintf(fp, ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                    "\"ts\": %" G_GINT64_FORMAT ", \"dur\": %" G_GINT64_FORMAT "}",
+                e->name, trace_category_names[e->category], e->tid, e->start_us, e->duration_us);
+    }
+    fputs("\n]}\n", fp);
+    g_mutex_unlock(&trace_mutex);
+    return fclose(fp) == 0;
+}
+
+void trace_start_from_env() {
+    if (g_getenv("STUDENTS_TRACE")) trace_set_enabled(TRUE);
+}
+
+// Write the trace STUDENTS_TRACE asked for, if any.
+void trace_finish() {
+    const char *path = g_getenv("STUDENTS_TRACE");
+    if (!path || !trace_events) return;
+    if (!trace_write(path)) g_printerr("Error: could not write trace %s\n", path);
+}
@@ -1,31 +1,12 @@
 #include <gtk/gtk.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
+#include <math.h>
+#include "students.h"
+#include "cli.h"
 
-#define MAX_STUDENTS 100
-#define FILE_NAME "students.dat"
-
-typedef struct {
-    int id;
-    char name[50];
-    char reg_num[20];
-    char branch[30];
-    char program[20];
-    char gender[10];
-    char phone[15];
-    int age;
-    float gpa;
-    struct {
-        char subject_name[50];
-        float marks;
-    } subjects[6];
-} Student;
-
-char default_subject_names[6][50] = {
-    "Subject 1", "Subject 2", "Subject 3", "Subject 4", "Subject 5", "Subject 6"
-};
+#define ANALYTICS_DELAY_MS 300
+#define PERF_OVERLAY_INTERVAL_MS 500
 
 // ================== STUDENT GOBJECT (GTK4) ==================
 
@@ -34,12 +15,19 @@ G_DECLARE_FINAL_TYPE(StudentObject, student_object, STUDENT, OBJECT, GObject)
 
 struct _StudentObject {
     GObject parent_instance;
-    Student *data; // Pointer to the underlying Student struct in the array
-    int index;     // Index in the global array
+    int id;        // Stable record id in the store
 };
 
 G_DEFINE_TYPE(StudentObject, student_object, G_TYPE_OBJECT)
 
+// Records are looked up on every access rather than cached, since the store
+// may move them when it grows
+static Student *student_object_get_data(StudentObject *self) {
+    return store_lookup(&store, self->id);
+}
+
+static void student_list_model_forget(StudentObject *obj);
+
 enum {
     PROP_0,
     PROP_NAME,
@@ -60,34 +48,34 @@ static void student_object_init(StudentObject *self) {
 
 static void student_object_get_property(GObject *object, guint property_id,
                                       GValue *value, GParamSpec *pspec) {
-    StudentObject *self = STUDENT_OBJECT(object);
+    Student *data = student_object_get_data(STUDENT_OBJECT(object));
     // Safety check
-    if (!self->data) return;
+    if (!data) return;
 
     switch (property_id) {
     case PROP_NAME:
-        g_value_set_string(value, self->data->name);
+        g_value_set_string(value, data->name);
         break;
     case PROP_REG_NUM:
-        g_value_set_string(value, self->data->reg_num);
+        g_value_set_string(value, data->reg_num);
         break;
     case PROP_BRANCH:
-        g_value_set_string(value, self->data->branch);
+        g_value_set_string(value, dict_name(DICT_BRANCH, data->branch));
         break;
     case PROP_PROGRAM:
-        g_value_set_string(value, self->data->program);
+        g_value_set_string(value, dict_name(DICT_PROGRAM, data->program));
         break;
     case PROP_GENDER:
-        g_value_set_string(value, self->data->gender);
+        g_value_set_string(value, dict_name(DICT_GENDER, data->gender));
         break;
     case PROP_PHONE:
-        g_value_set_string(value, self->data->phone);
+        g_value_set_string(value, data->phone);
         break;
     case PROP_AGE:
-        g_value_set_int(value, self->data->age);
+        g_value_set_int(value, data->age);
         break;
     case PROP_GPA:
-        g_value_set_float(value, self->data->gpa);
+        g_value_set_float(value, data->gpa);
         break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
@@ -101,10 +89,16 @@ static void student_object_set_property(GObject *object, guint property_id,
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
 }
 
+static void student_object_finalize(GObject *object) {
+    student_list_model_forget(STUDENT_OBJECT(object));
+    G_OBJECT_CLASS(student_object_parent_class)->finalize(object);
+}
+
 static void student_object_class_init(StudentObjectClass *klass) {
     GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
     gobject_class->get_property = student_object_get_property;
     gobject_class->set_property = student_object_set_property;
+    gobject_class->finalize = student_object_finalize;
 
     obj_properties[PROP_NAME] = g_param_spec_string("name", "Name", "Student Name",
         "", G_PARAM_READABLE);
@@ -126,22 +120,127 @@ static void student_object_class_init(StudentObjectClass *klass) {
     g_object_class_install_properties(gobject_class, N_PROPERTIES, obj_properties);
 }
 
-StudentObject *student_object_new(Student *data, int index) {
+StudentObject *student_object_new(int id) {
     StudentObject *obj = g_object_new(STUDENT_TYPE_OBJECT, NULL);
-    obj->data = data;
-    obj->index = index;
+    obj->id = id;
+    return obj;
+}
+
+// ================== STUDENT LIST MODEL ==================
+
+// GListModel read straight from the record store. Rows are every live
+// record or, while a search is active, the ids of the matches, either way in
+// the table's order: store order (ids are issued in store order, so both
+// orders agree) or the active column's cached permutation (see SORTING),
+// read backwards when descending. StudentObject wrappers are only created when the view asks for a
+// row in get_item, so memory follows the rows on screen rather than the
+// number of students. Wrappers that are still alive are remembered by record
+// id and handed out again, and forget themselves when finalized.
+
+#define STUDENT_TYPE_LIST_MODEL (student_list_model_get_type())
+G_DECLARE_FINAL_TYPE(StudentListModel, student_list_model, STUDENT, LIST_MODEL, GObject)
+
+struct _StudentListModel {
+    GObject parent_instance;
+    GArray *rows;       // Record ids shown while filtered, NULL shows all
+    GArray *order;      // Ids of all live records in sort order, NULL for store order (not owned)
+    gboolean descending;
+    GHashTable *live;   // Record id -> StudentObject handed out (not owned)
+};
+
+static void student_list_model_iface_init(GListModelInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(StudentListModel, student_list_model, G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(G_TYPE_LIST_MODEL, student_list_model_iface_init))
+
+StudentListModel *student_model;
+
+static GType student_list_model_get_item_type(GListModel *list) {
+    return STUDENT_TYPE_OBJECT;
+}
+
+static guint student_list_model_get_n_items(GListModel *list) {
+    StudentListModel *self = STUDENT_LIST_MODEL(list);
+    return self->rows ? self->rows->len : (guint)store_count(&store);
+}
+
+static gpointer student_list_model_get_item(GListModel *list, guint position) {
+    StudentListModel *self = STUDENT_LIST_MODEL(list);
+    if (position >= student_list_model_get_n_items(list)) return NULL;
+
+    int id;
+    if (self->rows) {
+        id = g_array_index(self->rows, int, position);
+    } else if (self->order) {
+        id = g_array_index(self->order, int, self->descending ? self->order->len - 1 - position : position);
+    } else {
+        id = store_get(&store, store_slot_at(&store, position))->id;
+    }
+    StudentObject *obj = g_hash_table_lookup(self->live, GINT_TO_POINTER(id));
+    if (obj) return g_object_ref(obj);
+
+    obj = student_object_new(id);
+    g_hash_table_insert(self->live, GINT_TO_POINTER(id), obj);
     return obj;
 }
 
-Student students[MAX_STUDENTS];
-int student_count = 0;
+static void student_list_model_iface_init(GListModelInterface *iface) {
+    iface->get_item_type = student_list_model_get_item_type;
+    iface->get_n_items = student_list_model_get_n_items;
+    iface->get_item = student_list_model_get_item;
+}
+
+static void student_list_model_finalize(GObject *object) {
+    StudentListModel *self = STUDENT_LIST_MODEL(object);
+    if (self->rows) g_array_free(self->rows, TRUE);
+    g_hash_table_destroy(self->live);
+    if (student_model == self) student_model = NULL;
+    G_OBJECT_CLASS(student_list_model_parent_class)->finalize(object);
+}
+
+static void student_list_model_init(StudentListModel *self) {
+    self->live = g_hash_table_new(g_direct_hash, g_direct_equal);
+}
+
+static void student_list_model_class_init(StudentListModelClass *klass) {
+    G_OBJECT_CLASS(klass)->finalize = student_list_model_finalize;
+}
+
+StudentListModel *student_list_model_new() {
+    return g_object_new(STUDENT_TYPE_LIST_MODEL, NULL);
+}
+
+// Called from StudentObject finalize.
+static void student_list_model_forget(StudentObject *obj) {
+    if (student_model &&
+        g_hash_table_lookup(student_model->live, GINT_TO_POINTER(obj->id)) == obj) {
+        g_hash_table_remove(student_model->live, GINT_TO_POINTER(obj->id));
+    }
+}
+
+// Show only the given ids, already in the table's order, or every student
+// when rows is NULL. Takes ownership of rows.
+void student_list_model_set_rows(StudentListModel *self, GArray *rows) {
+    guint removed = student_list_model_get_n_items(G_LIST_MODEL(self));
+    if (self->rows) g_array_free(self->rows, TRUE);
+    self->rows = rows;
+    g_list_model_items_changed(G_LIST_MODEL(self), 0, removed,
+                               student_list_model_get_n_items(G_LIST_MODEL(self)));
+}
+
+// Show unfiltered rows in the order of the given permutation (NULL for store
+// order), backwards when descending. The permutation must stay alive and in
+// step with the store; the caller refreshes the rows afterwards.
+void student_list_model_set_order(StudentListModel *self, GArray *order, gboolean descending) {
+    self->order = order;
+    self->descending = descending;
+}
 
 GtkWidget *window;
 GtkWidget *search_entry;
 GtkWidget *column_view; // Replaces tree_view
-GListStore *list_store; // Replaces GtkListStore
 GtkSingleSelection *selection_model; // For selection handling
-GtkWidget *total_label, *avg_gpa_label;
+GtkWidget *total_label, *avg_gpa_label, *median_gpa_label, *top_gpa_label;
 
 // Stack + form widgets
 GtkWidget *stack;
@@ -160,13 +259,38 @@ GtkWidget *dark_mode_switch;
 gboolean is_dark_mode = FALSE;
 GtkCssProvider *theme_provider = NULL;
 
+// top bar
+GtkWidget *persist_status_label = NULL;
+GtkWidget *export_progress = NULL;
+guint export_progress_source = 0;
+ExportJob *export_running = NULL;
+
+// analytics panel
+GtkWidget *analytics_expander;
+GtkWidget *gpa_histogram_area;
+GtkWidget *breakdown_area;
+GtkWidget *breakdown_dropdown;
+guint analytics_source = 0;
+
+// performance overlay
+GtkWidget *perf_overlay = NULL;
+GtkWidget *perf_overlay_label;
+guint perf_overlay_source = 0;
+
 // Function declarations
-void load_data();
-void save_data();
 void refresh_table();
+void table_row_inserted(int id);
+void table_row_updated(int id, const Student *before);
+void table_row_removed(int id, int slot);
+void search_schedule();
+void sort_table_by(int key, gboolean descending);
+int sort_object_compare(gconstpointer a, gconstpointer b, gpointer key);
+void on_sort_changed(GtkSorter *sorter, GtkSorterChange change, gpointer data);
+void analytics_schedule();
+GtkWidget *create_analytics_panel();
 void update_statistics();
-void show_edit_dialog(int index);
-void delete_student_by_index(int index);
+void show_edit_dialog(int id);
+void delete_student_by_id(int id);
 void on_search_changed(GtkEntry *entry, gpointer data);
 
 void on_delete_clicked(GtkButton *button, gpointer data);
@@ -175,6 +299,8 @@ void on_edit_clicked(GtkButton *button, gpointer data);
 void on_nav_list_clicked(GtkButton *button, gpointer data);
 void on_nav_add_clicked(GtkButton *button, gpointer data);
 void on_nav_about_clicked(GtkButton *button, gpointer data);
+void on_nav_import_clicked(GtkButton *button, gpointer data);
+void on_nav_export_clicked(GtkButton *button, gpointer data);
 void on_add_student_clicked(GtkButton *button, gpointer data);
 void on_cancel_add_clicked(GtkButton *button, gpointer data);
 void on_save_new_student_clicked(GtkButton *button, gpointer data);
@@ -216,44 +342,53 @@ void on_save_new_student_clicked(GtkButton *button, gpointer data) {
         return;
     }
 
-    if (student_count >= MAX_STUDENTS) {
-        g_print("Error: Max students reached\n");
+    Student student;
+    memset(&student, 0, sizeof(student));
+
+    strncpy(student.name, name, 49);
+    strncpy(student.reg_num, reg, 19);
+
+    if (store_find_reg(student.reg_num) >= 0) {
+        g_print("Error: Reg Num %s already exists\n", student.reg_num);
         return;
     }
 
-    int i = student_count;
-    
-    strncpy(students[i].name, name, 49);
-    strncpy(students[i].reg_num, reg, 19);
-
     GtkStringObject *branch_obj = gtk_drop_down_get_selected_item(GTK_DROP_DOWN(add_branch_combo));
     const char *branch = gtk_string_object_get_string(branch_obj);
-    strncpy(students[i].branch, branch, 29);
+    student.branch = dict_intern(DICT_BRANCH, branch);
 
     GtkStringObject *program_obj = gtk_drop_down_get_selected_item(GTK_DROP_DOWN(add_program_combo));
     const char *program = gtk_string_object_get_string(program_obj);
-    strncpy(students[i].program, program, 19);
+    student.program = dict_intern(DICT_PROGRAM, program);
 
     GtkStringObject *gender_obj = gtk_drop_down_get_selected_item(GTK_DROP_DOWN(add_gender_combo));
     const char *gender = gtk_string_object_get_string(gender_obj);
-    strncpy(students[i].gender, gender, 9);
+    student.gender = dict_intern(DICT_GENDER, gender);
 
     const char *phone = gtk_editable_get_text(GTK_EDITABLE(add_phone_entry));
-    strncpy(students[i].phone, phone, 14);
+    strncpy(student.phone, phone, 14);
 
-    students[i].age = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(add_age_spin));
-    students[i].gpa = (float)gtk_spin_button_get_value(GTK_SPIN_BUTTON(add_gpa_spin));
-    students[i].id = i + 1;
+    student.age = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(add_age_spin));
+    student.gpa = (float)gtk_spin_button_get_value(GTK_SPIN_BUTTON(add_gpa_spin));
 
     // Initialize subjects with default names
     for (int j = 0; j < 6; j++) {
-        strncpy(students[i].subjects[j].subject_name, default_subject_names[j], 49);
-        students[i].subjects[j].marks = 0.0;
+        student.subjects[j].subject_name = dict_intern(DICT_SUBJECT, default_subject_names[j]);
+        student.subjects[j].marks = 0.0;
+    }
+    if (!student_codes_valid(&student)) {
+        g_print("Error: Too many distinct branch, program, gender or subject names\n");
+        return;
     }
 
-    student_count++;
-    save_data();
-    refresh_table();
+    int slot = store_insert(&store, &student);
+    if (slot < 0) {
+        g_print("Error: Could not grow student store\n");
+        return;
+    }
+    Student *added = store_get(&store, slot);
+    journal_append(JOURNAL_OP_INSERT, added->id, added);
+    table_row_inserted(added->id);
     
     // Clear inputs
     gtk_editable_set_text(GTK_EDITABLE(add_name_entry), "");
@@ -323,6 +458,7 @@ void apply_theme(gboolean dark) {
         "switch:checked { background-color: #fce38a; border-color: #f6d365; }"
         "switch slider { background-color: #f59e0b; border-radius: 50%; margin: 3px; min-width: 20px; min-height: 20px; box-shadow: 0 2px 4px rgba(0,0,0,0.1); background-image: url('data:image/svg+xml;base64,PHN2ZyB4bWxucz0naHR0cDovL3d3dy53My5vcmcvMjAwMC9zdmcnIHdpZHRoPScyNCcgaGVpZ2h0PScyNCcgdmlld0JveD0nMCAwIDI0IDI0Jz48dGV4dCB4PSc1MCUnIHk9JzUwJScgZG9taW5hbnQtYmFzZWxpbmU9J2NlbnRyYWwnIHRleHQtYW5jaG9yPSdtaWRkbGUnIGZvbnQtc2l6ZT0nMTYnPuKYgO+4jzwvdGV4dD48L3N2Zz4='); }";
 
+    TRACE_BEGIN(span);
     if (!theme_provider) {
         theme_provider = gtk_css_provider_new();
     }
@@ -335,6 +471,7 @@ void apply_theme(gboolean dark) {
         GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
 
     is_dark_mode = dark;
+    TRACE_END(span, "apply_theme", TRACE_UI);
 }
 
 // ===================== DARK MODE / SIDEBAR BUTTONS =====================
@@ -388,7 +525,7 @@ GtkWidget* create_stat_card(const char *value, const char *label, const char *su
 }
 
 void on_search_changed(GtkEntry *entry, gpointer data) {
-    refresh_table();
+    search_schedule();
 }
 
 GtkWidget* create_list_page() {
@@ -407,6 +544,12 @@ GtkWidget* create_list_page() {
                    create_stat_card("0", "Total Students", NULL, &total_label));
     gtk_box_append(GTK_BOX(stats_box),
                    create_stat_card("0.00", "Average GPA", NULL, &avg_gpa_label));
+    gtk_box_append(GTK_BOX(stats_box),
+                   create_stat_card("0.00", "Median GPA", NULL, &median_gpa_label));
+    gtk_box_append(GTK_BOX(stats_box),
+                   create_stat_card("0.00", "Top 10% GPA", NULL, &top_gpa_label));
+
+    gtk_box_append(GTK_BOX(header), create_analytics_panel());
 
     // Search + Delete / Edit buttons
     GtkWidget *controls_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
@@ -414,7 +557,7 @@ GtkWidget* create_list_page() {
 
     search_entry = gtk_entry_new();
     gtk_entry_set_placeholder_text(GTK_ENTRY(search_entry),
-                                   "Search student by Name or Reg No.");
+                                   "Search by name or reg no., or filter: branch=CSE gpa>=8 age<21");
     gtk_widget_add_css_class(search_entry, "search-entry");
     gtk_widget_set_hexpand(search_entry, TRUE);
     gtk_box_append(GTK_BOX(controls_box), search_entry);
@@ -440,30 +583,38 @@ GtkWidget* create_list_page() {
     gtk_widget_set_name(column_view, "custom-tree"); // For CSS
     gtk_widget_add_css_class(column_view, "custom-tree");
 
-    list_store = g_list_store_new(STUDENT_TYPE_OBJECT);
-    selection_model = gtk_single_selection_new(G_LIST_MODEL(list_store));
+    student_model = student_list_model_new();
+    selection_model = gtk_single_selection_new(G_LIST_MODEL(student_model));
     gtk_column_view_set_model(GTK_COLUMN_VIEW(column_view), GTK_SELECTION_MODEL(selection_model));
     g_signal_connect(column_view, "activate", G_CALLBACK(on_student_row_activated), NULL);
 
     // Helper macro for columns
-    #define ADD_COLUMN(title, bind_func) \
+    #define ADD_COLUMN(title, bind_func, sort_key) \
         { \
             GtkListItemFactory *factory = gtk_signal_list_item_factory_new(); \
             g_signal_connect(factory, "setup", G_CALLBACK(setup_label_cb), NULL); \
             g_signal_connect(factory, "bind", G_CALLBACK(bind_func), NULL); \
             GtkColumnViewColumn *col = gtk_column_view_column_new(title, factory); \
+            GtkSorter *sorter = GTK_SORTER(gtk_custom_sorter_new(sort_object_compare, GINT_TO_POINTER(sort_key), NULL)); \
+            gtk_column_view_column_set_sorter(col, sorter); \
+            g_object_unref(sorter); \
+            g_object_set_data(G_OBJECT(col), "sort-key", GINT_TO_POINTER(sort_key)); \
             gtk_column_view_append_column(GTK_COLUMN_VIEW(column_view), col); \
             g_object_unref(col); \
         }
 
-    ADD_COLUMN("Full Name", bind_name_cb);
-    ADD_COLUMN("Reg Num", bind_reg_cb);
-    ADD_COLUMN("Branch", bind_branch_cb);
-    ADD_COLUMN("Program", bind_program_cb);
-    ADD_COLUMN("Gender", bind_gender_cb);
-    ADD_COLUMN("Phone", bind_phone_cb);
-    ADD_COLUMN("Age", bind_age_cb);
-    ADD_COLUMN("GPA", bind_gpa_cb);
+    ADD_COLUMN("Full Name", bind_name_cb, SORT_NAME);
+    ADD_COLUMN("Reg Num", bind_reg_cb, SORT_REG);
+    ADD_COLUMN("Branch", bind_branch_cb, SORT_BRANCH);
+    ADD_COLUMN("Program", bind_program_cb, SORT_PROGRAM);
+    ADD_COLUMN("Gender", bind_gender_cb, SORT_GENDER);
+    ADD_COLUMN("Phone", bind_phone_cb, SORT_PHONE);
+    ADD_COLUMN("Age", bind_age_cb, SORT_AGE);
+    ADD_COLUMN("GPA", bind_gpa_cb, SORT_GPA);
+
+    // Header clicks reorder through the cached permutations, not a GtkSortListModel
+    g_signal_connect(gtk_column_view_get_sorter(GTK_COLUMN_VIEW(column_view)), "changed",
+                     G_CALLBACK(on_sort_changed), NULL);
 
     gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled_window), column_view);
 
@@ -482,11 +633,11 @@ void on_delete_clicked(GtkButton *button, gpointer data) {
     }
 
     StudentObject *obj = STUDENT_OBJECT(g_list_model_get_item(G_LIST_MODEL(selection_model), position));
-    int index = obj->index;
+    int id = obj->id;
     g_object_unref(obj); // g_list_model_get_item returns a new reference
 
     // Delete directly (confirmation dialog is complex in GTK4 migration, skipping for now)
-    delete_student_by_index(index);
+    delete_student_by_id(id);
 }
 
 void on_edit_clicked(GtkButton *button, gpointer data) {
@@ -494,14 +645,30 @@ void on_edit_clicked(GtkButton *button, gpointer data) {
     if (position == GTK_INVALID_LIST_POSITION) return;
 
     StudentObject *obj = STUDENT_OBJECT(g_list_model_get_item(G_LIST_MODEL(selection_model), position));
-    int index = obj->index;
+    int id = obj->id;
     g_object_unref(obj);
 
-    show_edit_dialog(index);
+    show_edit_dialog(id);
 }
 
 // ================== COLUMN VIEW CALLBACKS ==================
 
+// Sorter of every column, so its header can be clicked. The model is never
+// wrapped in a GtkSortListModel, but the comparison is the column's real one.
+int sort_object_compare(gconstpointer a, gconstpointer b, gpointer key) {
+    const Student *x = store_lookup(&store, STUDENT_OBJECT((gpointer)a)->id);
+    const Student *y = store_lookup(&store, STUDENT_OBJECT((gpointer)b)->id);
+    if (!x || !y) return 0;
+    return sort_compare(GPOINTER_TO_INT(key), x, y);
+}
+
+void on_sort_changed(GtkSorter *sorter, GtkSorterChange change, gpointer data) {
+    GtkColumnViewSorter *view_sorter = GTK_COLUMN_VIEW_SORTER(sorter);
+    GtkColumnViewColumn *col = gtk_column_view_sorter_get_primary_sort_column(view_sorter);
+    int key = col ? GPOINTER_TO_INT(g_object_get_data(G_OBJECT(col), "sort-key")) : -1;
+    sort_table_by(key, gtk_column_view_sorter_get_primary_sort_order(view_sorter) == GTK_SORT_DESCENDING);
+}
+
 static void setup_label_cb(GtkSignalListItemFactory *factory, GtkListItem *list_item) {
     GtkWidget *label = gtk_label_new(NULL);
     gtk_widget_set_halign(label, GTK_ALIGN_START);
@@ -509,56 +676,73 @@ static void setup_label_cb(GtkSignalListItemFactory *factory, GtkListItem *list_
     gtk_list_item_set_child(list_item, label);
 }
 
+// A row whose record was deleted before the model dropped it binds blank.
 static void bind_name_cb(GtkSignalListItemFactory *factory, GtkListItem *list_item) {
+    TRACE_BEGIN(span);
     GtkWidget *label = gtk_list_item_get_child(list_item);
-    StudentObject *obj = STUDENT_OBJECT(gtk_list_item_get_item(list_item));
-    gtk_label_set_text(GTK_LABEL(label), obj->data->name);
+    Student *student = student_object_get_data(STUDENT_OBJECT(gtk_list_item_get_item(list_item)));
+    gtk_label_set_text(GTK_LABEL(label), student ? student->name : "");
+    TRACE_END(span, "bind_name", TRACE_UI);
 }
 
 static void bind_reg_cb(GtkSignalListItemFactory *factory, GtkListItem *list_item) {
+    TRACE_BEGIN(span);
     GtkWidget *label = gtk_list_item_get_child(list_item);
-    StudentObject *obj = STUDENT_OBJECT(gtk_list_item_get_item(list_item));
-    gtk_label_set_text(GTK_LABEL(label), obj->data->reg_num);
+    Student *student = student_object_get_data(STUDENT_OBJECT(gtk_list_item_get_item(list_item)));
+    gtk_label_set_text(GTK_LABEL(label), student ? student->reg_num : "");
+    TRACE_END(span, "bind_reg", TRACE_UI);
 }
 
 static void bind_branch_cb(GtkSignalListItemFactory *factory, GtkListItem *list_item) {
+    TRACE_BEGIN(span);
     GtkWidget *label = gtk_list_item_get_child(list_item);
-    StudentObject *obj = STUDENT_OBJECT(gtk_list_item_get_item(list_item));
-    gtk_label_set_text(GTK_LABEL(label), obj->data->branch);
+    Student *student = student_object_get_data(STUDENT_OBJECT(gtk_list_item_get_item(list_item)));
+    gtk_label_set_text(GTK_LABEL(label), student ? dict_name(DICT_BRANCH, student->branch) : "");
+    TRACE_END(span, "bind_branch", TRACE_UI);
 }
 
 static void bind_program_cb(GtkSignalListItemFactory *factory, GtkListItem *list_item) {
+    TRACE_BEGIN(span);
     GtkWidget *label = gtk_list_item_get_child(list_item);
-    StudentObject *obj = STUDENT_OBJECT(gtk_list_item_get_item(list_item));
-    gtk_label_set_text(GTK_LABEL(label), obj->data->program);
+    Student *student = student_object_get_data(STUDENT_OBJECT(gtk_list_item_get_item(list_item)));
+    gtk_label_set_text(GTK_LABEL(label), student ? dict_name(DICT_PROGRAM, student->program) : "");
+    TRACE_END(span, "bind_program", TRACE_UI);
 }
 
 static void bind_gender_cb(GtkSignalListItemFactory *factory, GtkListItem *list_item) {
+    TRACE_BEGIN(span);
     GtkWidget *label = gtk_list_item_get_child(list_item);
-    StudentObject *obj = STUDENT_OBJECT(gtk_list_item_get_item(list_item));
-    gtk_label_set_text(GTK_LABEL(label), obj->data->gender);
+    Student *student = student_object_get_data(STUDENT_OBJECT(gtk_list_item_get_item(list_item)));
+    gtk_label_set_text(GTK_LABEL(label), student ? dict_name(DICT_GENDER, student->gender) : "");
+    TRACE_END(span, "bind_gender", TRACE_UI);
 }
 
 static void bind_phone_cb(GtkSignalListItemFactory *factory, GtkListItem *list_item) {
+    TRACE_BEGIN(span);
     GtkWidget *label = gtk_list_item_get_child(list_item);
-    StudentObject *obj = STUDENT_OBJECT(gtk_list_item_get_item(list_item));
-    gtk_label_set_text(GTK_LABEL(label), obj->data->phone);
+    Student *student = student_object_get_data(STUDENT_OBJECT(gtk_list_item_get_item(list_item)));
+    gtk_label_set_text(GTK_LABEL(label), student ? student->phone : "");
+    TRACE_END(span, "bind_phone", TRACE_UI);
 }
 
 static void bind_age_cb(GtkSignalListItemFactory *factory, GtkListItem *list_item) {
+    TRACE_BEGIN(span);
     GtkWidget *label = gtk_list_item_get_child(list_item);
-    StudentObject *obj = STUDENT_OBJECT(gtk_list_item_get_item(list_item));
-    char buf[32];
-    snprintf(buf, sizeof(buf), "%d", obj->data->age);
+    Student *student = student_object_get_data(STUDENT_OBJECT(gtk_list_item_get_item(list_item)));
+    char buf[32] = "";
+    if (student) snprintf(buf, sizeof(buf), "%d", student->age);
     gtk_label_set_text(GTK_LABEL(label), buf);
+    TRACE_END(span, "bind_age", TRACE_UI);
 }
 
 static void bind_gpa_cb(GtkSignalListItemFactory *factory, GtkListItem *list_item) {
+    TRACE_BEGIN(span);
     GtkWidget *label = gtk_list_item_get_child(list_item);
-    StudentObject *obj = STUDENT_OBJECT(gtk_list_item_get_item(list_item));
-    char buf[32];
-    snprintf(buf, sizeof(buf), "%.2f", obj->data->gpa);
+    Student *student = student_object_get_data(STUDENT_OBJECT(gtk_list_item_get_item(list_item)));
+    char buf[32] = "";
+    if (student) snprintf(buf, sizeof(buf), "%.2f", student->gpa);
     gtk_label_set_text(GTK_LABEL(label), buf);
+    TRACE_END(span, "bind_gpa", TRACE_UI);
 }
 
 
@@ -593,20 +777,17 @@ GtkWidget* create_add_page() {
 
     // Branch
     gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Branch:"), 0, 2, 1, 1);
-    const char *branches[] = {"CSE", "IT", "ECE", "EEE", "Mechanical", "Civil", "Other", NULL};
-    add_branch_combo = gtk_drop_down_new_from_strings(branches);
+    add_branch_combo = gtk_drop_down_new_from_strings(branch_choices);
     gtk_grid_attach(GTK_GRID(grid), add_branch_combo, 1, 2, 1, 1);
 
     // Program
     gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Program:"), 0, 3, 1, 1);
-    const char *programs[] = {"BTECH", "MBA", "DIPLOMA", NULL};
-    add_program_combo = gtk_drop_down_new_from_strings(programs);
+    add_program_combo = gtk_drop_down_new_from_strings(program_choices);
     gtk_grid_attach(GTK_GRID(grid), add_program_combo, 1, 3, 1, 1);
 
     // Gender
     gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Gender:"), 0, 4, 1, 1);
-    const char *genders[] = {"Male", "Female", "Other", NULL};
-    add_gender_combo = gtk_drop_down_new_from_strings(genders);
+    add_gender_combo = gtk_drop_down_new_from_strings(gender_choices);
     gtk_grid_attach(GTK_GRID(grid), add_gender_combo, 1, 4, 1, 1);
 
     // Phone
@@ -764,7 +945,7 @@ GtkWidget *marks_name_label;
 GtkWidget *marks_reg_label;
 GtkWidget *subject_entries[6];
 GtkWidget *marks_spins[6];
-int current_marks_index = -1;
+int current_marks_id = -1;
 
 GtkWidget* create_marksheet_page() {
     GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 20);
@@ -831,35 +1012,47 @@ GtkWidget* create_marksheet_page() {
 void on_student_row_activated(GtkColumnView *view, guint position, gpointer data) {
     GtkSelectionModel *model = gtk_column_view_get_model(view);
     StudentObject *obj = STUDENT_OBJECT(g_list_model_get_item(G_LIST_MODEL(model), position));
+    Student *student = obj ? student_object_get_data(obj) : NULL;
     
-    if (obj && obj->data) {
-        current_marks_index = obj->index;
+    if (student) {
+        current_marks_id = obj->id;
         
-        gtk_label_set_text(GTK_LABEL(marks_name_label), obj->data->name);
-        gtk_label_set_text(GTK_LABEL(marks_reg_label), obj->data->reg_num);
+        gtk_label_set_text(GTK_LABEL(marks_name_label), student->name);
+        gtk_label_set_text(GTK_LABEL(marks_reg_label), student->reg_num);
 
         for (int i = 0; i < 6; i++) {
-            gtk_editable_set_text(GTK_EDITABLE(subject_entries[i]), obj->data->subjects[i].subject_name);
-            gtk_spin_button_set_value(GTK_SPIN_BUTTON(marks_spins[i]), obj->data->subjects[i].marks);
+            gtk_editable_set_text(GTK_EDITABLE(subject_entries[i]), dict_name(DICT_SUBJECT, student->subjects[i].subject_name));
+            gtk_spin_button_set_value(GTK_SPIN_BUTTON(marks_spins[i]), student->subjects[i].marks);
         }
 
         gtk_stack_set_visible_child_name(GTK_STACK(stack), "marksheet_page");
     }
+    if (obj) g_object_unref(obj);
 }
 
 void on_save_marks_clicked(GtkButton *button, gpointer data) {
-    if (current_marks_index >= 0 && current_marks_index < student_count) {
+    Student *current = store_lookup(&store, current_marks_id);
+    if (current) {
+        Student before = *current;
+        Student updated = *current;
         for (int i = 0; i < 6; i++) {
             const char *subj_name = gtk_editable_get_text(GTK_EDITABLE(subject_entries[i]));
             float marks = gtk_spin_button_get_value(GTK_SPIN_BUTTON(marks_spins[i]));
 
-            strncpy(students[current_marks_index].subjects[i].subject_name, subj_name, 49);
-            students[current_marks_index].subjects[i].marks = marks;
-
-            // Update global defaults (last saved wins)
-            strncpy(default_subject_names[i], subj_name, 49);
+            updated.subjects[i].subject_name = dict_intern(DICT_SUBJECT, subj_name);
+            updated.subjects[i].marks = marks;
         }
-        save_data();
+        if (!student_codes_valid(&updated)) {
+            g_print("Error: Too many distinct subject names\n");
+            return;
+        }
+        // Update global defaults (last saved wins)
+        for (int i = 0; i < 6; i++) {
+            strncpy(default_subject_names[i], gtk_editable_get_text(GTK_EDITABLE(subject_entries[i])), 49);
+        }
+        store_update(&store, current_marks_id, &updated);
+        journal_append(JOURNAL_OP_UPDATE, current_marks_id, &updated);
+        table_row_updated(current_marks_id, &before);
         gtk_stack_set_visible_child_name(GTK_STACK(stack), "list_page");
     }
 }
@@ -868,70 +1061,595 @@ void on_cancel_marks_clicked(GtkButton *button, gpointer data) {
     gtk_stack_set_visible_child_name(GTK_STACK(stack), "list_page");
 }
 
-void load_data() {
-    FILE *fp = fopen(FILE_NAME, "rb");
-    if (fp) {
-        fread(&student_count, sizeof(int), 1, fp);
-        fread(students, sizeof(Student), student_count, fp);
-        
-        // Load default subject names if available
-        if (student_count > 0) {
-             for(int i=0; i<6; i++) {
-                 if(strlen(students[0].subjects[i].subject_name) > 0) {
-                     strncpy(default_subject_names[i], students[0].subjects[i].subject_name, 49);
-                 }
-             }
+// Sort the table by key, or store order for -1, building the key's
+// permutation on first use.
+void sort_table_by(int key, gboolean descending) {
+    if (key >= 0 && !sort_orders[key]) {
+        GArray *order = sort_build(key);
+        g_rw_lock_writer_lock(&store_lock);
+        sort_orders[key] = order;
+        g_rw_lock_writer_unlock(&store_lock);
+    }
+    sort_active = key;
+    sort_descending = descending;
+    student_list_model_set_order(student_model, key >= 0 ? sort_orders[key] : NULL, descending);
+    refresh_table();
+}
+
+// ================== ASYNC SEARCH ==================
+
+// Filtering the table runs on a GTask worker, so typing never waits for
+// it. Keystrokes are debounced. Each query is compiled on the main thread,
+// the only one that may read the dictionaries. The worker then evaluates
+// it and puts the matches in table order under store_lock, and the rows
+// are applied to the model in one batch back on the main loop.
+//
+// A newer search supersedes the one in flight and cancels it. A store
+// change cancels it too, and a search interrupted by a change, or finished
+// before one, runs again instead of showing stale rows.
+
+#define SEARCH_DEBOUNCE_MS 150
+
+typedef struct {
+    Query *query;
+    int sort_key;
+    gboolean descending;
+    guint generation;
+    guint64 writes;  // store_writes the rows were computed at
+} SearchJob;
+
+GCancellable *search_cancellable = NULL;  // Of the search in flight
+guint search_generation = 0;
+guint search_debounce_source = 0;
+GMutex search_mutex;                      // Workers take turns with the search index
+
+static void search_job_free(gpointer data) {
+    SearchJob *job = data;
+    query_free(job->query);
+    g_free(job);
+}
+
+static void search_thread(GTask *task, gpointer source, gpointer data, GCancellable *cancellable) {
+    SearchJob *job = data;
+    GArray *rows = NULL;
+
+    g_mutex_lock(&search_mutex);
+    TRACE_BEGIN(span);
+    g_rw_lock_reader_lock(&store_lock);
+    job->writes = store_writes;
+    guint64 *bits = query_run(job->query, cancellable);
+    if (bits) {
+        rows = g_array_new(FALSE, FALSE, sizeof(int));
+        for (int w = 0; w < (store_slots(&store) + 63) / 64; w++) {
+            for (guint64 left = bits[w]; left; left &= left - 1) {
+                int id = store.records[w * 64 + __builtin_ctzll(left)].id;
+                g_array_append_val(rows, id);
+            }
         }
-        
-        fclose(fp);
+        sort_rows(rows, job->sort_key, job->descending);
+        g_free(bits);
     }
+    g_rw_lock_reader_unlock(&store_lock);
+    TRACE_END(span, "search_run", TRACE_SEARCH);
+    g_mutex_unlock(&search_mutex);
+
+    if (rows) g_task_return_pointer(task, rows, (GDestroyNotify)g_array_unref);
+    else g_task_return_error_if_cancelled(task);
 }
 
-void save_data() {
-    FILE *fp = fopen(FILE_NAME, "wb");
-    if (fp) {
-        fwrite(&student_count, sizeof(int), 1, fp);
-        fwrite(students, sizeof(Student), student_count, fp);
-        fclose(fp);
+static void search_done(GObject *source, GAsyncResult *result, gpointer data) {
+    SearchJob *job = g_task_get_task_data(G_TASK(result));
+    GArray *rows = g_task_propagate_pointer(G_TASK(result), NULL);
+    if (job->generation != search_generation || !student_model) {
+        if (rows) g_array_unref(rows);
+        return;
     }
+
+    g_clear_object(&search_cancellable);
+    if (!rows || job->writes != store_writes) {
+        if (rows) g_array_unref(rows);
+        refresh_table();
+        return;
+    }
+    TRACE_BEGIN(span);
+    student_list_model_set_rows(student_model, rows);
+    TRACE_END(span, "apply_rows", TRACE_MODEL);
+}
+
+// Cancel the search in flight on behalf of a store change; it reruns.
+static void search_interrupt() {
+    if (search_cancellable) g_cancellable_cancel(search_cancellable);
+}
+
+// Drop the search in flight, whose rows are no longer wanted.
+static void search_supersede() {
+    search_generation++;
+    if (search_cancellable) {
+        g_cancellable_cancel(search_cancellable);
+        g_clear_object(&search_cancellable);
+    }
+}
+
+// Evaluate plan on a worker and show its rows. Takes ownership of plan.
+static void search_start(Query *plan) {
+    SearchJob *job = g_new0(SearchJob, 1);
+    job->query = plan;
+    job->sort_key = sort_active;
+    job->descending = sort_descending;
+    job->generation = search_generation;
+
+    search_cancellable = g_cancellable_new();
+    GTask *task = g_task_new(NULL, search_cancellable, search_done, NULL);
+    g_task_set_task_data(task, job, search_job_free);
+    g_task_run_in_thread(task, search_thread);
+    g_object_unref(task);
+}
+
+static gboolean search_debounce_timeout(gpointer data) {
+    search_debounce_source = 0;
+    refresh_table();
+    return G_SOURCE_REMOVE;
+}
+
+// Refresh the table once typing pauses.
+void search_schedule() {
+    search_supersede();
+    if (search_debounce_source) g_source_remove(search_debounce_source);
+    search_debounce_source = g_timeout_add(SEARCH_DEBOUNCE_MS, search_debounce_timeout, NULL);
+}
+
+static gboolean analytics_timeout(gpointer data) {
+    analytics_source = 0;
+    if (!gtk_expander_get_expanded(GTK_EXPANDER(analytics_expander))) return G_SOURCE_REMOVE;
+
+    analytics_compute();
+    gtk_widget_queue_draw(breakdown_area);
+    return G_SOURCE_REMOVE;
+}
+
+// Recompute the aggregates once edits have been quiet for a moment.
+void analytics_schedule() {
+    if (analytics_expander) gtk_widget_queue_draw(gpa_histogram_area);
+    if (analytics.generation == gpa_stats.generation || analytics_source || !analytics_expander) return;
+    analytics_source = g_timeout_add(ANALYTICS_DELAY_MS, analytics_timeout, NULL);
+}
+
+static void chart_set_color(cairo_t *cr, gboolean accent, double alpha) {
+    if (accent) {
+        if (is_dark_mode) cairo_set_source_rgba(cr, 0.69, 0.15, 1.0, alpha);
+        else cairo_set_source_rgba(cr, 0.99, 0.63, 0.52, alpha);
+    } else {
+        if (is_dark_mode) cairo_set_source_rgba(cr, 1.0, 1.0, 1.0, alpha);
+        else cairo_set_source_rgba(cr, 0.18, 0.14, 0.13, alpha);
+    }
+}
+
+// GPA distribution in half-point bins, straight from the running histogram.
+static void draw_gpa_histogram(GtkDrawingArea *area, cairo_t *cr, int width, int height, gpointer data) {
+    enum { BINS = 20, PER_BIN = (GPA_BUCKETS - 1) / BINS };
+    int bins[BINS] = {0};
+    int peak = 0;
+    for (int b = 0; b < GPA_BUCKETS; b++) {
+        int bin = MIN(b / PER_BIN, BINS - 1);
+        bins[bin] += gpa_stats.buckets[b];
+        peak = MAX(peak, bins[bin]);
+    }
+
+    double axis = height - 16.0;
+    double slot = width / (double)BINS;
+    chart_set_color(cr, TRUE, 0.85);
+    for (int i = 0; i < BINS && peak > 0; i++) {
+        double h = (axis - 4) * bins[i] / peak;
+        cairo_rectangle(cr, i * slot + 1, axis - h, slot - 2, h);
+    }
+    cairo_fill(cr);
+
+    chart_set_color(cr, FALSE, 0.7);
+    cairo_set_font_size(cr, 10);
+    for (int gpa = 0; gpa <= 10; gpa += 2) {
+        char tick[8];
+        snprintf(tick, sizeof(tick), "%d", gpa);
+        cairo_move_to(cr, MIN(gpa * width / 10.0, width - 12.0), height - 3);
+        cairo_show_text(cr, tick);
+    }
+}
+
+// One bar per group (mean GPA) or per subject (mean marks), with a tick at
+// the median and the inter-quartile range drawn as a thin line.
+static void draw_breakdown(GtkDrawingArea *area, cairo_t *cr, int width, int height, gpointer data) {
+    guint dim = gtk_drop_down_get_selected(GTK_DROP_DOWN(breakdown_dropdown));
+    int rows = dim < DICT_GROUP_FIELDS ? analytics.group_count[dim] : 6;
+    if (analytics.generation == 0 || rows == 0) return;
+
+    double row_h = MIN(22.0, height / (double)rows);
+    double bar_x = width * 0.3, bar_w = width * 0.45;
+    cairo_set_font_size(cr, 11);
+
+    for (int r = 0; r < rows; r++) {
+        const char *name;
+        int count;
+        double mean, q1, median, q3, scale;
+        if (dim < DICT_GROUP_FIELDS) {
+            const GroupAggregate *g = &analytics.groups[dim][r];
+            name = g->name;
+            count = g->count;
+            mean = group_mean(g);
+            q1 = group_percentile(g, 0.25);
+            median = group_percentile(g, 0.5);
+            q3 = group_percentile(g, 0.75);
+            scale = 10.0;
+        } else {
+            const MarkDistribution *m = &analytics.marks[r];
+            name = default_subject_names[r];
+            count = m->count;
+            mean = count > 0 ? m->sum / count : 0.0;
+            q1 = histogram_percentile(m->hist, MARK_BUCKETS, count, 0.25);
+            median = histogram_percentile(m->hist, MARK_BUCKETS, count, 0.5);
+            q3 = histogram_percentile(m->hist, MARK_BUCKETS, count, 0.75);
+            scale = 100.0;
+        }
+
+        double y = r * row_h;
+        chart_set_color(cr, FALSE, 0.9);
+        cairo_move_to(cr, 0, y + row_h * 0.7);
+        cairo_show_text(cr, name);
+
+        chart_set_color(cr, TRUE, 0.85);
+        cairo_rectangle(cr, bar_x, y + row_h * 0.25, bar_w * mean / scale, row_h * 0.5);
+        cairo_fill(cr);
+
+        chart_set_color(cr, FALSE, 0.8);
+        cairo_set_line_width(cr, 1);
+        cairo_move_to(cr, bar_x + bar_w * q1 / scale, y + row_h * 0.5);
+        cairo_line_to(cr, bar_x + bar_w * q3 / scale, y + row_h * 0.5);
+        cairo_move_to(cr, bar_x + bar_w * median / scale, y + row_h * 0.15);
+        cairo_line_to(cr, bar_x + bar_w * median / scale, y + row_h * 0.85);
+        cairo_stroke(cr);
+
+        char text[64];
+        snprintf(text, sizeof(text), "%.2f  med %.2f  n=%d", mean, median, count);
+        cairo_move_to(cr, bar_x + bar_w + 8, y + row_h * 0.7);
+        cairo_show_text(cr, text);
+    }
+}
+
+static void on_analytics_expanded(GObject *expander, GParamSpec *pspec, gpointer data) {
+    analytics_schedule();
+}
+
+static void on_breakdown_changed(GObject *dropdown, GParamSpec *pspec, gpointer data) {
+    gtk_widget_queue_draw(breakdown_area);
+}
+
+GtkWidget *create_analytics_panel() {
+    analytics_expander = gtk_expander_new("Analytics");
+    g_signal_connect(analytics_expander, "notify::expanded", G_CALLBACK(on_analytics_expanded), NULL);
+
+    GtkWidget *charts = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
+    gtk_expander_set_child(GTK_EXPANDER(analytics_expander), charts);
+
+    GtkWidget *histogram_card = gtk_box_new(GTK_ORIENTATION_VERTICAL, 5);
+    gtk_widget_add_css_class(histogram_card, "stat-card");
+    gtk_widget_set_hexpand(histogram_card, TRUE);
+    GtkWidget *histogram_label = gtk_label_new("GPA Distribution");
+    gtk_widget_add_css_class(histogram_label, "stat-label");
+    gtk_widget_set_halign(histogram_label, GTK_ALIGN_START);
+    gtk_box_append(GTK_BOX(histogram_card), histogram_label);
+    gpa_histogram_area = gtk_drawing_area_new();
+    gtk_drawing_area_set_content_height(GTK_DRAWING_AREA(gpa_histogram_area), 140);
+    gtk_drawing_area_set_draw_func(GTK_DRAWING_AREA(gpa_histogram_area), draw_gpa_histogram, NULL, NULL);
+    gtk_box_append(GTK_BOX(histogram_card), gpa_histogram_area);
+    gtk_box_append(GTK_BOX(charts), histogram_card);
+
+    GtkWidget *breakdown_card = gtk_box_new(GTK_ORIENTATION_VERTICAL, 5);
+    gtk_widget_add_css_class(breakdown_card, "stat-card");
+    gtk_widget_set_hexpand(breakdown_card, TRUE);
+    const char *dimensions[] = {"By Branch", "By Program", "By Gender", "Subject Marks", NULL};
+    breakdown_dropdown = gtk_drop_down_new_from_strings(dimensions);
+    gtk_widget_set_halign(breakdown_dropdown, GTK_ALIGN_START);
+    g_signal_connect(breakdown_dropdown, "notify::selected", G_CALLBACK(on_breakdown_changed), NULL);
+    gtk_box_append(GTK_BOX(breakdown_card), breakdown_dropdown);
+    breakdown_area = gtk_drawing_area_new();
+    gtk_drawing_area_set_content_height(GTK_DRAWING_AREA(breakdown_area), 140);
+    gtk_drawing_area_set_draw_func(GTK_DRAWING_AREA(breakdown_area), draw_breakdown, NULL, NULL);
+    gtk_box_append(GTK_BOX(breakdown_card), breakdown_area);
+    gtk_box_append(GTK_BOX(charts), breakdown_card);
+
+    return analytics_expander;
+}
+
+static void import_thread(GTask *task, gpointer source, gpointer data, GCancellable *cancellable) {
+    char *error = NULL;
+    ImportBatch *batch = import_parse(data, &error);
+    if (batch) g_task_return_pointer(task, batch, (GDestroyNotify)import_batch_free);
+    else g_task_return_new_error(task, G_FILE_ERROR, G_FILE_ERROR_FAILED, "%s", error);
+    g_free(error);
+}
+
+static void import_done(GObject *source, GAsyncResult *result, gpointer data) {
+    GError *error = NULL;
+    ImportBatch *batch = g_task_propagate_pointer(G_TASK(result), &error);
+    GtkAlertDialog *alert;
+    if (batch) {
+        int added = import_commit(batch);
+        char *summary = import_summary(batch, added);
+        alert = gtk_alert_dialog_new("%s", summary);
+        g_free(summary);
+        import_batch_free(batch);
+        refresh_table();
+        update_statistics();
+    } else {
+        alert = gtk_alert_dialog_new("Import failed: %s", error->message);
+        g_error_free(error);
+    }
+    gtk_alert_dialog_show(alert, GTK_WINDOW(window));
+    g_object_unref(alert);
+}
+
+static void on_import_file_chosen(GObject *source, GAsyncResult *result, gpointer data) {
+    GFile *file = gtk_file_dialog_open_finish(GTK_FILE_DIALOG(source), result, NULL);
+    if (!file) return;
+    GTask *task = g_task_new(NULL, NULL, import_done, NULL);
+    g_task_set_task_data(task, g_file_get_path(file), g_free);
+    g_task_run_in_thread(task, import_thread);
+    g_object_unref(task);
+    g_object_unref(file);
+}
+
+void on_nav_import_clicked(GtkButton *button, gpointer data) {
+    GtkFileDialog *dialog = gtk_file_dialog_new();
+    gtk_file_dialog_set_title(dialog, "Import Students from CSV");
+    GtkFileFilter *filter = gtk_file_filter_new();
+    gtk_file_filter_set_name(filter, "CSV files");
+    gtk_file_filter_add_suffix(filter, "csv");
+    GListStore *filters = g_list_store_new(GTK_TYPE_FILE_FILTER);
+    g_list_store_append(filters, filter);
+    gtk_file_dialog_set_filters(dialog, G_LIST_MODEL(filters));
+    gtk_file_dialog_open(dialog, GTK_WINDOW(window), NULL, on_import_file_chosen, NULL);
+    g_object_unref(filters);
+    g_object_unref(filter);
+    g_object_unref(dialog);
+}
+
+static void export_thread(GTask *task, gpointer source, gpointer data, GCancellable *cancellable) {
+    char *error = NULL;
+    if (export_students(data, cancellable, &error)) g_task_return_boolean(task, TRUE);
+    else g_task_return_new_error(task, G_FILE_ERROR, G_FILE_ERROR_FAILED, "%s", error);
+    g_free(error);
+}
+
+static gboolean export_progress_tick(gpointer data) {
+    if (!export_running || !export_progress) return G_SOURCE_CONTINUE;
+    int progress = g_atomic_int_get(&export_running->progress);
+    char text[32];
+    snprintf(text, sizeof(text), "Exporting %d%%", progress / 10);
+    gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(export_progress), progress / 1000.0);
+    gtk_progress_bar_set_text(GTK_PROGRESS_BAR(export_progress), text);
+    return G_SOURCE_CONTINUE;
+}
+
+static void export_done(GObject *source, GAsyncResult *result, gpointer data) {
+    ExportJob *job = g_task_get_task_data(G_TASK(result));
+    GError *error = NULL;
+    GtkAlertDialog *alert;
+    if (g_task_propagate_boolean(G_TASK(result), &error)) {
+        alert = gtk_alert_dialog_new("Exported %d students to %s", job->exported, job->path);
+    } else {
+        alert = gtk_alert_dialog_new("Export failed: %s", error->message);
+        g_error_free(error);
+    }
+    export_running = NULL;
+    g_source_remove(export_progress_source);
+    export_progress_source = 0;
+    if (export_progress) gtk_widget_set_visible(export_progress, FALSE);
+    gtk_alert_dialog_show(alert, GTK_WINDOW(window));
+    g_object_unref(alert);
+}
+
+static void on_export_file_chosen(GObject *source, GAsyncResult *result, gpointer data) {
+    GFile *file = gtk_file_dialog_save_finish(GTK_FILE_DIALOG(source), result, NULL);
+    if (!file) return;
+    char *path = g_file_get_path(file);
+    g_object_unref(file);
+    if (!path || export_running) {
+        g_free(path);
+        return;
+    }
+
+    export_running = export_job_new(path, export_format_for_path(path));
+    g_free(path);
+    gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(export_progress), 0.0);
+    gtk_widget_set_visible(export_progress, TRUE);
+    export_progress_source = g_timeout_add(100, export_progress_tick, NULL);
+
+    GTask *task = g_task_new(NULL, NULL, export_done, NULL);
+    g_task_set_task_data(task, export_running, (GDestroyNotify)export_job_free);
+    g_task_run_in_thread(task, export_thread);
+    g_object_unref(task);
+}
+
+void on_nav_export_clicked(GtkButton *button, gpointer data) {
+    if (export_running) return;
+    GtkFileDialog *dialog = gtk_file_dialog_new();
+    gtk_file_dialog_set_title(dialog, "Export Students (.csv, .json, or .txt marksheets)");
+    gtk_file_dialog_set_initial_name(dialog, "students.csv");
+    gtk_file_dialog_save(dialog, GTK_WINDOW(window), NULL, on_export_file_chosen, NULL);
+    g_object_unref(dialog);
 }
 
 void update_statistics() {
     char buf[32];
-    snprintf(buf, sizeof(buf), "%d", student_count);
+    int count = store_count(&store);
+    snprintf(buf, sizeof(buf), "%d", count);
     gtk_label_set_text(GTK_LABEL(total_label), buf);
 
-    if (student_count > 0) {
-        float total_gpa = 0;
-        for (int i = 0; i < student_count; i++) {
-            total_gpa += students[i].gpa;
-        }
-        snprintf(buf, sizeof(buf), "%.2f", total_gpa / student_count);
+    if (count > 0) {
+        snprintf(buf, sizeof(buf), "%.2f", stats_mean());
         gtk_label_set_text(GTK_LABEL(avg_gpa_label), buf);
+        char tip[96];
+        snprintf(tip, sizeof(tip), "Min %.2f  Max %.2f  Std dev %.2f",
+                 stats_min(), stats_max(), stats_stddev());
+        gtk_widget_set_tooltip_text(avg_gpa_label, tip);
+
+        snprintf(buf, sizeof(buf), "%.2f", stats_percentile(0.5));
+        gtk_label_set_text(GTK_LABEL(median_gpa_label), buf);
+        snprintf(tip, sizeof(tip), "25th percentile %.2f  75th percentile %.2f",
+                 stats_percentile(0.25), stats_percentile(0.75));
+        gtk_widget_set_tooltip_text(median_gpa_label, tip);
+
+        snprintf(buf, sizeof(buf), "%.2f", stats_percentile(0.9));
+        gtk_label_set_text(GTK_LABEL(top_gpa_label), buf);
     } else {
         gtk_label_set_text(GTK_LABEL(avg_gpa_label), "0.00");
+        gtk_widget_set_tooltip_text(avg_gpa_label, NULL);
+        gtk_label_set_text(GTK_LABEL(median_gpa_label), "0.00");
+        gtk_widget_set_tooltip_text(median_gpa_label, NULL);
+        gtk_label_set_text(GTK_LABEL(top_gpa_label), "0.00");
     }
+    analytics_schedule();
 }
 
+// Show the students matching the search box, in the table's order. Plain
+// store order is shown at once; a search runs on a worker (see ASYNC
+// SEARCH) and replaces the rows when it finishes.
 void refresh_table() {
-    g_list_store_remove_all(list_store);
-    for (int i = 0; i < student_count; i++) {
-        StudentObject *obj = student_object_new(&students[i], i);
-        g_list_store_append(list_store, obj);
-        g_object_unref(obj);
+    TRACE_BEGIN(span);
+    const char *query = search_entry ? gtk_editable_get_text(GTK_EDITABLE(search_entry)) : "";
+    search_supersede();
+
+    char *error = NULL;
+    Query *plan = query[strspn(query, " \t")] != '\0' ? query_compile(query, &error) : NULL;
+    if (search_entry) {
+        // A malformed filter shows no rows and says why
+        if (error) gtk_widget_add_css_class(search_entry, "error");
+        else gtk_widget_remove_css_class(search_entry, "error");
+        gtk_widget_set_tooltip_text(search_entry, error);
     }
+
+    if (plan) {
+        search_start(plan);
+    } else {
+        student_list_model_set_rows(student_model, error ? g_array_new(FALSE, FALSE, sizeof(int)) : NULL);
+    }
+    g_free(error);
     update_statistics();
+    TRACE_END(span, "refresh_table", TRACE_MODEL);
 }
 
-void delete_student_by_index(int index) {
-    if (index < 0 || index >= student_count) return;
-    
-    for (int i = index; i < student_count - 1; i++) {
-        students[i] = students[i + 1];
+// ================== TABLE UPDATES ==================
+
+// Single-record changes are reported to the view as items-changed for just
+// the affected positions, so no other row is rebound. Unfiltered positions
+// come from the store's live order, or from the active permutation (which
+// the store has already updated) while sorted; while filtered, the model's
+// rows array is patched in place in the table's order. An edit under a sort
+// may move the row, and the span between its old and new positions is
+// reported instead. Compaction never reorders records or changes ids, so it
+// needs no updates here.
+
+static gboolean table_row_visible(int id) {
+    return !student_model->rows ||
+           search_matches(store_lookup(&store, id), gtk_editable_get_text(GTK_EDITABLE(search_entry)));
+}
+
+// Position in rows where student belongs, or is if self is set.
+static guint table_lower_bound(GArray *rows, const Student *student, gboolean self) {
+    return sort_lower_bound(rows, sort_active, sort_descending, student, self);
+}
+
+// Unfiltered table position of the entry at index in the active
+// permutation, which has len entries.
+static guint table_sorted_position(guint index, guint len) {
+    return sort_descending ? len - 1 - index : index;
+}
+
+void table_row_inserted(int id) {
+    GArray *rows = student_model->rows;
+    const Student *student = store_lookup(&store, id);
+    if (!rows) {
+        guint position;
+        if (sort_active < 0) {
+            position = store_position_of(&store, store_slot_of(&store, id));
+        } else {
+            GArray *order = sort_orders[sort_active];
+            position = table_sorted_position(sort_lower_bound(order, sort_active, FALSE, student, TRUE), order->len);
+        }
+        g_list_model_items_changed(G_LIST_MODEL(student_model), position, 0, 1);
+    } else if (table_row_visible(id)) {
+        guint position = table_lower_bound(rows, student, FALSE);
+        g_array_insert_val(rows, position, id);
+        g_list_model_items_changed(G_LIST_MODEL(student_model), position, 0, 1);
     }
-    student_count--;
-    save_data();
-    refresh_table();
+    update_statistics();
+}
+
+// before is the record as it was ahead of the edit.
+void table_row_updated(int id, const Student *before) {
+    // Drop the cached wrapper so the view gets a new item and rebinds the row
+    g_hash_table_remove(student_model->live, GINT_TO_POINTER(id));
+
+    GArray *rows = student_model->rows;
+    const Student *student = store_lookup(&store, id);
+    if (!rows && sort_active < 0) {
+        guint position = store_position_of(&store, store_slot_of(&store, id));
+        g_list_model_items_changed(G_LIST_MODEL(student_model), position, 1, 1);
+    } else if (!rows) {
+        // Where the old record would go now is its old index or one past it
+        GArray *order = sort_orders[sort_active];
+        guint from = sort_lower_bound(order, sort_active, FALSE, before, FALSE);
+        guint to = sort_lower_bound(order, sort_active, FALSE, student, TRUE);
+        guint lo = MIN(from, to), hi = MIN(MAX(from, to) + 1, order->len);
+        guint position = sort_descending ? order->len - hi : lo;
+        g_list_model_items_changed(G_LIST_MODEL(student_model), position, hi - lo, hi - lo);
+    } else {
+        guint from = table_lower_bound(rows, before, TRUE);
+        gboolean shown = from < rows->len && g_array_index(rows, int, from) == id;
+        gboolean visible = table_row_visible(id);
+
+        if (shown) g_array_remove_index(rows, from);
+        guint to = visible ? table_lower_bound(rows, student, FALSE) : from;
+        if (visible) g_array_insert_val(rows, to, id);
+
+        if (shown && visible) {
+            guint lo = MIN(from, to), hi = MAX(from, to) + 1;
+            g_list_model_items_changed(G_LIST_MODEL(student_model), lo, hi - lo, hi - lo);
+        } else if (shown || visible) {
+            g_list_model_items_changed(G_LIST_MODEL(student_model), shown ? from : to, shown, visible);
+        }
+    }
+    update_statistics();
+}
+
+// Called after store_remove tombstoned id's slot, whose record is still intact.
+void table_row_removed(int id, int slot) {
+    GArray *rows = student_model->rows;
+    const Student *student = &store.records[slot];
+    if (!rows) {
+        guint position;
+        if (sort_active < 0) {
+            position = store_position_of(&store, slot);
+        } else {
+            // The permutation has already lost the row, so count it back in
+            GArray *order = sort_orders[sort_active];
+            position = table_sorted_position(sort_lower_bound(order, sort_active, FALSE, student, FALSE), order->len + 1);
+        }
+        g_list_model_items_changed(G_LIST_MODEL(student_model), position, 1, 0);
+    } else {
+        guint position = table_lower_bound(rows, student, TRUE);
+        if (position < rows->len && g_array_index(rows, int, position) == id) {
+            g_array_remove_index(rows, position);
+            g_list_model_items_changed(G_LIST_MODEL(student_model), position, 1, 0);
+        }
+    }
+    update_statistics();
+}
+
+void delete_student_by_id(int id) {
+    int slot = store_remove(&store, id);
+    if (slot < 0) return;
+
+    journal_append(JOURNAL_OP_DELETE, id, NULL);
+    table_row_removed(id, slot);
 }
 
 // Navigation Callbacks
@@ -953,35 +1671,47 @@ void on_cancel_add_clicked(GtkButton *button, gpointer data) {
 
 // Edit Dialog
 GtkWidget *edit_name_entry, *edit_reg_entry, *edit_branch_combo, *edit_program_combo, *edit_gender_combo, *edit_phone_entry, *edit_age_spin, *edit_gpa_spin;
-int edit_index = -1;
+int edit_id = -1;
 
 void on_save_edit_clicked(GtkButton *button, gpointer data) {
     GtkWidget *dialog = GTK_WIDGET(data);
     
-    if (edit_index >= 0 && edit_index < student_count) {
+    Student *current = store_lookup(&store, edit_id);
+    if (current) {
+        Student before = *current;
+        Student updated = *current;
         const char *name = gtk_editable_get_text(GTK_EDITABLE(edit_name_entry));
         const char *reg = gtk_editable_get_text(GTK_EDITABLE(edit_reg_entry));
         
-        strncpy(students[edit_index].name, name, 49);
-        strncpy(students[edit_index].reg_num, reg, 19);
+        strncpy(updated.name, name, 49);
+        strncpy(updated.reg_num, reg, 19);
         
         GtkStringObject *branch_obj = gtk_drop_down_get_selected_item(GTK_DROP_DOWN(edit_branch_combo));
-        strncpy(students[edit_index].branch, gtk_string_object_get_string(branch_obj), 29);
+        updated.branch = dict_intern(DICT_BRANCH, gtk_string_object_get_string(branch_obj));
 
         GtkStringObject *program_obj = gtk_drop_down_get_selected_item(GTK_DROP_DOWN(edit_program_combo));
-        strncpy(students[edit_index].program, gtk_string_object_get_string(program_obj), 19);
+        updated.program = dict_intern(DICT_PROGRAM, gtk_string_object_get_string(program_obj));
         
         GtkStringObject *gender_obj = gtk_drop_down_get_selected_item(GTK_DROP_DOWN(edit_gender_combo));
-        strncpy(students[edit_index].gender, gtk_string_object_get_string(gender_obj), 9);
+        updated.gender = dict_intern(DICT_GENDER, gtk_string_object_get_string(gender_obj));
 
         const char *phone = gtk_editable_get_text(GTK_EDITABLE(edit_phone_entry));
-        strncpy(students[edit_index].phone, phone, 14);
+        strncpy(updated.phone, phone, 14);
         
-        students[edit_index].age = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(edit_age_spin));
-        students[edit_index].gpa = (float)gtk_spin_button_get_value(GTK_SPIN_BUTTON(edit_gpa_spin));
-        
-        save_data();
-        refresh_table();
+        updated.age = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(edit_age_spin));
+        updated.gpa = (float)gtk_spin_button_get_value(GTK_SPIN_BUTTON(edit_gpa_spin));
+
+        if (!student_codes_valid(&updated)) {
+            g_print("Error: Too many distinct branch, program or gender names\n");
+            return;
+        }
+        if (!store_update(&store, edit_id, &updated)) {
+            // Leave the dialog open so the reg number can be corrected
+            g_print("Error: Reg Num %s already exists\n", updated.reg_num);
+            return;
+        }
+        journal_append(JOURNAL_OP_UPDATE, edit_id, &updated);
+        table_row_updated(edit_id, &before);
     }
     
     gtk_window_destroy(GTK_WINDOW(dialog));
@@ -992,8 +1722,11 @@ void on_cancel_edit_clicked(GtkButton *button, gpointer data) {
     gtk_window_destroy(GTK_WINDOW(dialog));
 }
 
-void show_edit_dialog(int index) {
-    edit_index = index;
+void show_edit_dialog(int id) {
+    Student *student = store_lookup(&store, id);
+    if (!student) return;
+
+    edit_id = id;
     GtkWidget *dialog = gtk_window_new();
     gtk_window_set_title(GTK_WINDOW(dialog), "Edit Student");
     gtk_window_set_transient_for(GTK_WINDOW(dialog), GTK_WINDOW(window));
@@ -1015,20 +1748,19 @@ void show_edit_dialog(int index) {
     // Fields
     gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Name:"), 0, 0, 1, 1);
     edit_name_entry = gtk_entry_new();
-    gtk_editable_set_text(GTK_EDITABLE(edit_name_entry), students[index].name);
+    gtk_editable_set_text(GTK_EDITABLE(edit_name_entry), student->name);
     gtk_grid_attach(GTK_GRID(grid), edit_name_entry, 1, 0, 1, 1);
 
     gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Reg Num:"), 0, 1, 1, 1);
     edit_reg_entry = gtk_entry_new();
-    gtk_editable_set_text(GTK_EDITABLE(edit_reg_entry), students[index].reg_num);
+    gtk_editable_set_text(GTK_EDITABLE(edit_reg_entry), student->reg_num);
     gtk_grid_attach(GTK_GRID(grid), edit_reg_entry, 1, 1, 1, 1);
 
     gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Branch:"), 0, 2, 1, 1);
-    const char *branches[] = {"CSE", "IT", "ECE", "EEE", "Mechanical", "Civil", "Other", NULL};
-    edit_branch_combo = gtk_drop_down_new_from_strings(branches);
+    edit_branch_combo = gtk_drop_down_new_from_strings(branch_choices);
     // Select current branch (simple loop)
-    for(int i=0; branches[i]; i++) {
-        if(strcmp(branches[i], students[index].branch) == 0) {
+    for(int i=0; branch_choices[i]; i++) {
+        if(strcmp(branch_choices[i], dict_name(DICT_BRANCH, student->branch)) == 0) {
             gtk_drop_down_set_selected(GTK_DROP_DOWN(edit_branch_combo), i);
             break;
         }
@@ -1036,10 +1768,9 @@ void show_edit_dialog(int index) {
     gtk_grid_attach(GTK_GRID(grid), edit_branch_combo, 1, 2, 1, 1);
 
     gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Program:"), 0, 3, 1, 1);
-    const char *programs[] = {"BTECH", "MBA", "DIPLOMA", NULL};
-    edit_program_combo = gtk_drop_down_new_from_strings(programs);
-    for(int i=0; programs[i]; i++) {
-        if(strcmp(programs[i], students[index].program) == 0) {
+    edit_program_combo = gtk_drop_down_new_from_strings(program_choices);
+    for(int i=0; program_choices[i]; i++) {
+        if(strcmp(program_choices[i], dict_name(DICT_PROGRAM, student->program)) == 0) {
             gtk_drop_down_set_selected(GTK_DROP_DOWN(edit_program_combo), i);
             break;
         }
@@ -1047,10 +1778,9 @@ void show_edit_dialog(int index) {
     gtk_grid_attach(GTK_GRID(grid), edit_program_combo, 1, 3, 1, 1);
 
     gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Gender:"), 0, 4, 1, 1);
-    const char *genders[] = {"Male", "Female", "Other", NULL};
-    edit_gender_combo = gtk_drop_down_new_from_strings(genders);
-    for(int i=0; genders[i]; i++) {
-        if(strcmp(genders[i], students[index].gender) == 0) {
+    edit_gender_combo = gtk_drop_down_new_from_strings(gender_choices);
+    for(int i=0; gender_choices[i]; i++) {
+        if(strcmp(gender_choices[i], dict_name(DICT_GENDER, student->gender)) == 0) {
             gtk_drop_down_set_selected(GTK_DROP_DOWN(edit_gender_combo), i);
             break;
         }
@@ -1059,17 +1789,17 @@ void show_edit_dialog(int index) {
 
     gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Phone:"), 0, 5, 1, 1);
     edit_phone_entry = gtk_entry_new();
-    gtk_editable_set_text(GTK_EDITABLE(edit_phone_entry), students[index].phone);
+    gtk_editable_set_text(GTK_EDITABLE(edit_phone_entry), student->phone);
     gtk_grid_attach(GTK_GRID(grid), edit_phone_entry, 1, 5, 1, 1);
 
     gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Age:"), 0, 6, 1, 1);
     edit_age_spin = gtk_spin_button_new_with_range(16, 60, 1);
-    gtk_spin_button_set_value(GTK_SPIN_BUTTON(edit_age_spin), students[index].age);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(edit_age_spin), student->age);
     gtk_grid_attach(GTK_GRID(grid), edit_age_spin, 1, 6, 1, 1);
 
     gtk_grid_attach(GTK_GRID(grid), gtk_label_new("GPA:"), 0, 7, 1, 1);
     edit_gpa_spin = gtk_spin_button_new_with_range(0.0, 10.0, 0.01);
-    gtk_spin_button_set_value(GTK_SPIN_BUTTON(edit_gpa_spin), students[index].gpa);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(edit_gpa_spin), student->gpa);
     gtk_grid_attach(GTK_GRID(grid), edit_gpa_spin, 1, 7, 1, 1);
 
     // Buttons
@@ -1089,6 +1819,148 @@ void show_edit_dialog(int index) {
     gtk_window_present(GTK_WINDOW(dialog));
 }
 
+// ================== ENGINE HOOKS ==================
+
+// The record engine (core/) knows nothing of GTK; these keep the window in
+// step with it.
+
+static void persist_show_status() {
+    if (!persist_status_label) return;
+    if (persist_failed) {
+        gtk_label_set_text(GTK_LABEL(persist_status_label), "Save failed");
+        gtk_widget_add_css_class(persist_status_label, "error");
+    } else {
+        gtk_label_set_text(GTK_LABEL(persist_status_label),
+                           persist_pending > 0 ? "Saving…" : "All changes saved");
+        gtk_widget_remove_css_class(persist_status_label, "error");
+    }
+}
+
+// Bulk loads and imports drop or rebuild the permutations under the model.
+static void on_sort_orders_changed() {
+    if (!student_model) return;
+    GArray *order = sort_active >= 0 ? sort_orders[sort_active] : NULL;
+    student_list_model_set_order(student_model, order, order && sort_descending);
+}
+
+// ================== PERFORMANCE OVERLAY ==================
+
+// F12 shows frame, model, search and I/O timings from the trace summaries,
+// refreshed twice a second. Tracing runs while the overlay is up, or for the
+// whole session under STUDENTS_TRACE.
+
+static gint64 frame_start = 0;
+
+// Frame time is the frame clock's layout and paint phases, which include
+// binding the rows that scrolled into view.
+static void on_frame_begin(GdkFrameClock *clock, gpointer data) {
+    TRACE_BEGIN(span);
+    frame_start = span;
+}
+
+static void on_frame_end(GdkFrameClock *clock, gpointer data) {
+    TRACE_END(frame_start, "frame", TRACE_FRAME);
+    frame_start = 0;
+}
+
+static void on_window_realize(GtkWidget *widget, gpointer data) {
+    GdkFrameClock *clock = gtk_widget_get_frame_clock(widget);
+    g_signal_connect(clock, "before-paint", G_CALLBACK(on_frame_begin), NULL);
+    g_signal_connect(clock, "after-paint", G_CALLBACK(on_frame_end), NULL);
+}
+
+static void perf_overlay_line(GString *text, const char *label, TraceCategory category) {
+    TraceSummary summary;
+    trace_take_summary(category, &summary);
+    if (summary.count > 0) {
+        g_string_append_printf(text, "%-7s %8.2f ms  max %8.2f  ×%d\n", label,
+                               summary.total_us / 1000.0 / summary.count,
+                               summary.max_us / 1000.0, summary.count);
+    } else {
+        g_string_append_printf(text, "%-7s %8.2f ms  (last)\n", label, summary.last_us / 1000.0);
+    }
+}
+
+static gboolean perf_overlay_tick(gpointer data) {
+    GString *text = g_string_new(NULL);
+    perf_overlay_line(text, "Frame", TRACE_FRAME);
+    perf_overlay_line(text, "Rows", TRACE_MODEL);
+    perf_overlay_line(text, "Search", TRACE_SEARCH);
+    perf_overlay_line(text, "I/O", TRACE_IO);
+    perf_overlay_line(text, "Bind", TRACE_UI);
+    g_string_truncate(text, text->len - 1);
+    gtk_label_set_text(GTK_LABEL(perf_overlay_label), text->str);
+    g_string_free(text, TRUE);
+    return G_SOURCE_CONTINUE;
+}
+
+static void perf_overlay_set_visible(gboolean visible) {
+    gtk_widget_set_visible(perf_overlay, visible);
+    if (visible && !perf_overlay_source) {
+        trace_set_enabled(TRUE);
+        perf_overlay_tick(NULL);
+        perf_overlay_source = g_timeout_add(PERF_OVERLAY_INTERVAL_MS, perf_overlay_tick, NULL);
+    } else if (!visible && perf_overlay_source) {
+        g_source_remove(perf_overlay_source);
+        perf_overlay_source = 0;
+        if (!g_getenv("STUDENTS_TRACE")) trace_set_enabled(FALSE);
+    }
+}
+
+static gboolean on_perf_overlay_shortcut(GtkWidget *widget, GVariant *args, gpointer data) {
+    perf_overlay_set_visible(!gtk_widget_get_visible(perf_overlay));
+    return TRUE;
+}
+
+static void on_trace_file_chosen(GObject *source, GAsyncResult *result, gpointer data) {
+    GFile *file = gtk_file_dialog_save_finish(GTK_FILE_DIALOG(source), result, NULL);
+    if (!file) return;
+    char *path = g_file_get_path(file);
+    g_object_unref(file);
+    if (path && !trace_write(path)) {
+        GtkAlertDialog *alert = gtk_alert_dialog_new("Could not write %s", path);
+        gtk_alert_dialog_show(alert, GTK_WINDOW(window));
+        g_object_unref(alert);
+    }
+    g_free(path);
+}
+
+static void on_save_trace_clicked(GtkButton *button, gpointer data) {
+    GtkFileDialog *dialog = gtk_file_dialog_new();
+    gtk_file_dialog_set_title(dialog, "Save Trace (open in Perfetto or chrome://tracing)");
+    gtk_file_dialog_set_initial_name(dialog, "students-trace.json");
+    gtk_file_dialog_save(dialog, GTK_WINDOW(window), NULL, on_trace_file_chosen, NULL);
+    g_object_unref(dialog);
+}
+
+GtkWidget *create_perf_overlay() {
+    perf_overlay = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
+    gtk_widget_add_css_class(perf_overlay, "osd");
+    gtk_widget_set_halign(perf_overlay, GTK_ALIGN_END);
+    gtk_widget_set_valign(perf_overlay, GTK_ALIGN_END);
+    gtk_widget_set_margin_end(perf_overlay, 16);
+    gtk_widget_set_margin_bottom(perf_overlay, 16);
+
+    perf_overlay_label = gtk_label_new(NULL);
+    gtk_widget_add_css_class(perf_overlay_label, "monospace");
+    gtk_label_set_xalign(GTK_LABEL(perf_overlay_label), 0);
+    gtk_widget_set_can_target(perf_overlay_label, FALSE);
+    gtk_widget_set_margin_top(perf_overlay_label, 8);
+    gtk_widget_set_margin_start(perf_overlay_label, 10);
+    gtk_widget_set_margin_end(perf_overlay_label, 10);
+    gtk_box_append(GTK_BOX(perf_overlay), perf_overlay_label);
+
+    GtkWidget *save_button = gtk_button_new_with_label("Save Trace…");
+    gtk_widget_set_margin_start(save_button, 10);
+    gtk_widget_set_margin_end(save_button, 10);
+    gtk_widget_set_margin_bottom(save_button, 8);
+    g_signal_connect(save_button, "clicked", G_CALLBACK(on_save_trace_clicked), NULL);
+    gtk_box_append(GTK_BOX(perf_overlay), save_button);
+
+    gtk_widget_set_visible(perf_overlay, FALSE);
+    return perf_overlay;
+}
+
 void activate(GtkApplication *app, gpointer user_data) {
     window = gtk_application_window_new(app);
     gtk_window_set_title(GTK_WINDOW(window), "Student Data Management");
@@ -1100,6 +1972,16 @@ void activate(GtkApplication *app, gpointer user_data) {
 
     GtkWidget *hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
     gtk_overlay_set_child(GTK_OVERLAY(overlay), hbox);
+    gtk_overlay_add_overlay(GTK_OVERLAY(overlay), create_perf_overlay());
+
+    // F12 toggles the performance overlay
+    GtkEventController *shortcuts = gtk_shortcut_controller_new();
+    gtk_shortcut_controller_set_scope(GTK_SHORTCUT_CONTROLLER(shortcuts), GTK_SHORTCUT_SCOPE_GLOBAL);
+    gtk_shortcut_controller_add_shortcut(GTK_SHORTCUT_CONTROLLER(shortcuts),
+        gtk_shortcut_new(gtk_keyval_trigger_new(GDK_KEY_F12, 0),
+                         gtk_callback_action_new(on_perf_overlay_shortcut, NULL, NULL)));
+    gtk_widget_add_controller(window, shortcuts);
+    g_signal_connect(window, "realize", G_CALLBACK(on_window_realize), NULL);
 
     // Sidebar
     sidebar_revealer = gtk_revealer_new();
@@ -1142,6 +2024,20 @@ void activate(GtkApplication *app, gpointer user_data) {
     g_signal_connect(nav_add, "clicked", G_CALLBACK(on_nav_add_clicked), NULL);
     gtk_box_append(GTK_BOX(sidebar_box), nav_add);
 
+    GtkWidget *nav_import = gtk_button_new_with_label("Import CSV");
+    gtk_widget_add_css_class(nav_import, "sidebar-nav-button");
+    gtk_widget_set_margin_start(nav_import, 10);
+    gtk_widget_set_margin_end(nav_import, 10);
+    g_signal_connect(nav_import, "clicked", G_CALLBACK(on_nav_import_clicked), NULL);
+    gtk_box_append(GTK_BOX(sidebar_box), nav_import);
+
+    GtkWidget *nav_export = gtk_button_new_with_label("Export");
+    gtk_widget_add_css_class(nav_export, "sidebar-nav-button");
+    gtk_widget_set_margin_start(nav_export, 10);
+    gtk_widget_set_margin_end(nav_export, 10);
+    g_signal_connect(nav_export, "clicked", G_CALLBACK(on_nav_export_clicked), NULL);
+    gtk_box_append(GTK_BOX(sidebar_box), nav_export);
+
     GtkWidget *nav_about = gtk_button_new_with_label("About Us");
     gtk_widget_add_css_class(nav_about, "sidebar-nav-button");
     gtk_widget_set_margin_start(nav_about, 10);
@@ -1170,6 +2066,19 @@ void activate(GtkApplication *app, gpointer user_data) {
     gtk_widget_set_hexpand(spacer, TRUE);
     gtk_box_append(GTK_BOX(top_bar), spacer);
 
+    // Export progress, shown while one runs
+    export_progress = gtk_progress_bar_new();
+    gtk_progress_bar_set_show_text(GTK_PROGRESS_BAR(export_progress), TRUE);
+    gtk_widget_set_valign(export_progress, GTK_ALIGN_CENTER);
+    gtk_widget_set_visible(export_progress, FALSE);
+    gtk_box_append(GTK_BOX(top_bar), export_progress);
+
+    // Save status, updated by the writer thread
+    persist_status_label = gtk_label_new("All changes saved");
+    gtk_widget_add_css_class(persist_status_label, "dim-label");
+    gtk_box_append(GTK_BOX(top_bar), persist_status_label);
+    persist_show_status();
+
     // Dark Mode Toggle (Moved to Top Right)
     dark_mode_switch = gtk_switch_new();
     gtk_widget_set_valign(dark_mode_switch, GTK_ALIGN_CENTER);
@@ -1212,6 +2121,16 @@ void activate(GtkApplication *app, gpointer user_data) {
 }
 
 int main(int argc, char **argv) {
+    trace_start_from_env();
+    if (argc >= 2 && cli_is_command(argv[1])) {
+        int status = cli_main(argc, argv);
+        trace_finish();
+        return status;
+    }
+
+    core_hooks.store_changing = search_interrupt;
+    core_hooks.persist_changed = persist_show_status;
+    core_hooks.sort_changed = on_sort_orders_changed;
     load_data();
 
     GtkApplication *app = gtk_application_new("com.example.studentrecords",
@@ -1219,7 +2138,12 @@ int main(int argc, char **argv) {
     g_signal_connect(app, "activate", G_CALLBACK(activate), NULL);
 
     int status = g_application_run(G_APPLICATION(app), argc, argv);
+    persist_status_label = NULL;
+    export_progress = NULL;
     g_object_unref(app);
+    persist_shutdown();
+    trace_finish();
 
     return status;
 }
+